@@ -0,0 +1,331 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include "opencv2/opencv.hpp"
+
+#include "VideoStabilizer.h"
+#include "Settings.h"
+#include "FrameData.h"
+
+using namespace OrientView;
+
+namespace
+{
+	struct BenchmarkOptions
+	{
+		int frameCount = 300;
+		int width = 480;
+		int height = 270;
+		int seed = 1234;
+		double shake = 4.0;				// standard deviation of the per frame shake in pixels
+		double rotation = 0.5;			// standard deviation of the per frame shake in degrees
+		double noise = 4.0;				// standard deviation of the sensor noise in gray levels
+		double blur = 1.5;				// maximum gaussian blur sigma
+		QString imageFilePath = "";
+	};
+
+	struct SyntheticSequence
+	{
+		std::vector<cv::Mat> frames;
+		std::vector<FramePosition> groundTruth;
+		int64_t frameDuration = 33333;
+	};
+
+	struct BenchmarkResult
+	{
+		double framesPerSecond = 0.0;
+		double averageDuration = 0.0;
+		double deltaErrorX = 0.0;
+		double deltaErrorY = 0.0;
+		double deltaErrorAngle = 0.0;
+		double driftX = 0.0;
+		double driftY = 0.0;
+		double driftAngle = 0.0;
+	};
+
+	// something that looks a bit like an orienteering map: open areas, vegetation blobs, paths and contour lines
+	cv::Mat generateTexture(int width, int height, cv::RNG& rng)
+	{
+		cv::Mat texture(height, width, CV_8UC1, cv::Scalar(235));
+
+		for (int i = 0; i < (width * height) / 4000; ++i)
+		{
+			cv::Point center(rng.uniform(0, width), rng.uniform(0, height));
+			cv::Size axes(rng.uniform(5, 60), rng.uniform(5, 60));
+			cv::ellipse(texture, center, axes, rng.uniform(0.0, 180.0), 0.0, 360.0, cv::Scalar(rng.uniform(120, 220)), -1, CV_AA);
+		}
+
+		for (int i = 0; i < (width * height) / 20000; ++i)
+		{
+			std::vector<cv::Point> points;
+			cv::Point point(rng.uniform(0, width), rng.uniform(0, height));
+
+			for (int j = 0; j < 20; ++j)
+			{
+				points.push_back(point);
+				point += cv::Point(rng.uniform(-40, 41), rng.uniform(-40, 41));
+			}
+
+			const cv::Point* pointsData = &points[0];
+			int pointCount = (int)points.size();
+			cv::polylines(texture, &pointsData, &pointCount, 1, false, cv::Scalar(rng.uniform(0, 100)), rng.uniform(1, 4), CV_AA);
+		}
+
+		cv::Mat grain(texture.size(), CV_8UC1);
+		cv::randn(grain, cv::Scalar(128), cv::Scalar(12));
+		cv::GaussianBlur(grain, grain, cv::Size(0, 0), 1.0);
+		cv::addWeighted(texture, 1.0, grain, 1.0, -128.0, texture);
+
+		return texture;
+	}
+
+	cv::Mat toHomogeneous(const cv::Mat& transformation)
+	{
+		cv::Mat result = cv::Mat::eye(3, 3, CV_64F);
+		transformation.copyTo(result(cv::Rect(0, 0, 3, 2)));
+		return result;
+	}
+
+	SyntheticSequence generateSequence(const BenchmarkOptions& options)
+	{
+		cv::RNG rng(options.seed);
+		cv::Mat source;
+
+		// leave enough room around the frame that the shake never shows the borders
+		cv::Size sourceSize(options.width * 2, options.height * 2);
+
+		if (!options.imageFilePath.isEmpty())
+		{
+			source = cv::imread(options.imageFilePath.toStdString(), CV_LOAD_IMAGE_GRAYSCALE);
+
+			if (source.empty())
+				printf("Could not read %s, using a generated texture\n", qPrintable(options.imageFilePath));
+			else
+				cv::resize(source, source, sourceSize, 0.0, 0.0, cv::INTER_AREA);
+		}
+
+		if (source.empty())
+			source = generateTexture(sourceSize.width, sourceSize.height, rng);
+
+		SyntheticSequence sequence;
+		cv::Mat previousWarp;
+		double walkX = 0.0;
+		double walkY = 0.0;
+		double walkAngle = 0.0;
+		double cumulativeX = 0.0;
+		double cumulativeY = 0.0;
+		double cumulativeAngle = 0.0;
+
+		for (int i = 0; i < options.frameCount; ++i)
+		{
+			// slow wandering of a runner plus high frequency shake of the head
+			walkX = 0.98 * walkX + rng.gaussian(1.0);
+			walkY = 0.98 * walkY + rng.gaussian(1.0);
+			walkAngle = 0.98 * walkAngle + rng.gaussian(0.1);
+
+			double x = walkX + rng.gaussian(options.shake);
+			double y = walkY + rng.gaussian(options.shake);
+			double angle = walkAngle + rng.gaussian(options.rotation);
+
+			// source center goes to the frame center, rotated and shifted
+			cv::Mat warp = cv::getRotationMatrix2D(cv::Point2f(sourceSize.width / 2.0f, sourceSize.height / 2.0f), angle, 1.0);
+			warp.at<double>(0, 2) += options.width / 2.0 - sourceSize.width / 2.0 + x;
+			warp.at<double>(1, 2) += options.height / 2.0 - sourceSize.height / 2.0 + y;
+
+			cv::Mat frame;
+			cv::warpAffine(source, frame, warp, cv::Size(options.width, options.height), cv::INTER_LINEAR, cv::BORDER_REFLECT);
+
+			double blurSigma = rng.uniform(0.0, options.blur);
+
+			if (blurSigma > 0.3)
+				cv::GaussianBlur(frame, frame, cv::Size(0, 0), blurSigma);
+
+			if (options.noise > 0.0)
+			{
+				cv::Mat noise(frame.size(), CV_16SC1);
+				cv::randn(noise, cv::Scalar(0), cv::Scalar(options.noise));
+				frame.convertTo(frame, CV_16SC1);
+				frame += noise;
+				frame.convertTo(frame, CV_8UC1);
+			}
+
+			// the same definition of the frame to frame motion that the stabilizer uses
+			if (!previousWarp.empty())
+			{
+				cv::Mat motion = toHomogeneous(warp) * toHomogeneous(previousWarp).inv();
+
+				cumulativeX += motion.at<double>(0, 2) / options.width;
+				cumulativeY += motion.at<double>(1, 2) / options.height;
+				cumulativeAngle += atan2(motion.at<double>(1, 0), motion.at<double>(1, 1)) * 180.0 / M_PI;
+			}
+
+			FramePosition fp;
+			fp.timeStamp = i;
+			fp.x = cumulativeX;
+			fp.y = cumulativeY;
+			fp.angle = cumulativeAngle;
+
+			sequence.frames.push_back(frame);
+			sequence.groundTruth.push_back(fp);
+			previousWarp = warp;
+		}
+
+		return sequence;
+	}
+
+	BenchmarkResult runBenchmark(const SyntheticSequence& sequence, VideoStabilizerEstimator estimator)
+	{
+		BenchmarkResult result;
+
+		Settings settings;
+		settings.stabilizer.enabled = true;
+		settings.stabilizer.mode = VideoStabilizerMode::Preprocessed;
+		settings.stabilizer.estimator = estimator;
+
+		VideoStabilizer videoStabilizer;
+
+		if (!videoStabilizer.initialize(&settings, true))
+			return result;
+
+		std::vector<FramePosition> framePositions;
+		QElapsedTimer timer;
+		double totalDuration = 0.0;
+
+		for (size_t i = 0; i < sequence.frames.size(); ++i)
+		{
+			const cv::Mat& frame = sequence.frames.at(i);
+
+			FrameData frameDataGrayscale;
+			frameDataGrayscale.data = frame.data;
+			frameDataGrayscale.dataLength = frame.total();
+			frameDataGrayscale.rowLength = frame.step;
+			frameDataGrayscale.width = frame.cols;
+			frameDataGrayscale.height = frame.rows;
+			frameDataGrayscale.duration = sequence.frameDuration;
+			frameDataGrayscale.timeStamp = (int64_t)i;
+			frameDataGrayscale.cumulativeNumber = (int64_t)i;
+
+			timer.restart();
+			framePositions.push_back(videoStabilizer.calculateCumulativeFramePosition(frameDataGrayscale));
+			totalDuration += timer.nsecsElapsed() / 1000000.0;
+		}
+
+		int frameCount = (int)framePositions.size();
+
+		if (frameCount < 2)
+			return result;
+
+		result.averageDuration = totalDuration / frameCount;
+		result.framesPerSecond = 1000.0 / std::max(result.averageDuration, 0.000001);
+
+		int width = sequence.frames.front().cols;
+		int height = sequence.frames.front().rows;
+
+		// per frame errors show the estimator accuracy, the drift at the end shows how the errors add up
+		for (int i = 1; i < frameCount; ++i)
+		{
+			const FramePosition& estimated = framePositions.at(i);
+			const FramePosition& estimatedPrevious = framePositions.at(i - 1);
+			const FramePosition& truth = sequence.groundTruth.at(i);
+			const FramePosition& truthPrevious = sequence.groundTruth.at(i - 1);
+
+			double errorX = ((estimated.x - estimatedPrevious.x) - (truth.x - truthPrevious.x)) * width;
+			double errorY = ((estimated.y - estimatedPrevious.y) - (truth.y - truthPrevious.y)) * height;
+			double errorAngle = (estimated.angle - estimatedPrevious.angle) - (truth.angle - truthPrevious.angle);
+
+			result.deltaErrorX += errorX * errorX;
+			result.deltaErrorY += errorY * errorY;
+			result.deltaErrorAngle += errorAngle * errorAngle;
+		}
+
+		result.deltaErrorX = sqrt(result.deltaErrorX / (frameCount - 1));
+		result.deltaErrorY = sqrt(result.deltaErrorY / (frameCount - 1));
+		result.deltaErrorAngle = sqrt(result.deltaErrorAngle / (frameCount - 1));
+
+		result.driftX = (framePositions.back().x - sequence.groundTruth.back().x) * width;
+		result.driftY = (framePositions.back().y - sequence.groundTruth.back().y) * height;
+		result.driftAngle = framePositions.back().angle - sequence.groundTruth.back().angle;
+
+		return result;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("stabilizer-benchmark");
+
+	BenchmarkOptions options;
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Runs the video stabilizer estimators on a synthetic shaky sequence with a known trajectory.");
+	parser.addHelpOption();
+
+	QCommandLineOption framesOption("frames", "Number of frames.", "count", QString::number(options.frameCount));
+	QCommandLineOption widthOption("width", "Analysis frame width.", "pixels", QString::number(options.width));
+	QCommandLineOption heightOption("height", "Analysis frame height.", "pixels", QString::number(options.height));
+	QCommandLineOption seedOption("seed", "Random seed.", "seed", QString::number(options.seed));
+	QCommandLineOption shakeOption("shake", "Shake standard deviation.", "pixels", QString::number(options.shake));
+	QCommandLineOption rotationOption("rotation", "Rotation shake standard deviation.", "degrees", QString::number(options.rotation));
+	QCommandLineOption noiseOption("noise", "Noise standard deviation.", "levels", QString::number(options.noise));
+	QCommandLineOption blurOption("blur", "Maximum blur sigma.", "pixels", QString::number(options.blur));
+	QCommandLineOption imageOption("image", "Use an image (for example a map) instead of a generated texture.", "file");
+
+	parser.addOption(framesOption);
+	parser.addOption(widthOption);
+	parser.addOption(heightOption);
+	parser.addOption(seedOption);
+	parser.addOption(shakeOption);
+	parser.addOption(rotationOption);
+	parser.addOption(noiseOption);
+	parser.addOption(blurOption);
+	parser.addOption(imageOption);
+	parser.process(app);
+
+	options.frameCount = std::max(2, parser.value(framesOption).toInt());
+	options.width = std::max(32, parser.value(widthOption).toInt());
+	options.height = std::max(32, parser.value(heightOption).toInt());
+	options.seed = parser.value(seedOption).toInt();
+	options.shake = parser.value(shakeOption).toDouble();
+	options.rotation = parser.value(rotationOption).toDouble();
+	options.noise = parser.value(noiseOption).toDouble();
+	options.blur = parser.value(blurOption).toDouble();
+	options.imageFilePath = parser.value(imageOption);
+
+	printf("Generating %d frames of %dx%d (seed %d)\n\n", options.frameCount, options.width, options.height, options.seed);
+
+	SyntheticSequence sequence = generateSequence(options);
+
+	struct
+	{
+		const char* name;
+		VideoStabilizerEstimator estimator;
+	} estimators[] =
+	{
+		{ "feature tracking", VideoStabilizerEstimator::FeatureTracking },
+		{ "phase correlation", VideoStabilizerEstimator::PhaseCorrelation },
+		{ "phase corr. + rotation", VideoStabilizerEstimator::PhaseCorrelationRotation }
+	};
+
+	printf("%-24s %10s %10s %10s %10s %10s %10s %10s %10s\n", "estimator", "fps", "ms/frame", "err x px", "err y px", "err deg", "drift x", "drift y", "drift deg");
+
+	for (const auto& entry : estimators)
+	{
+		BenchmarkResult result = runBenchmark(sequence, entry.estimator);
+		printf("%-24s %10.1f %10.3f %10.3f %10.3f %10.4f %10.2f %10.2f %10.3f\n", entry.name, result.framesPerSecond, result.averageDuration, result.deltaErrorX, result.deltaErrorY, result.deltaErrorAngle, result.driftX, result.driftY, result.driftAngle);
+	}
+
+	printf("\nErrors are the RMS of the per frame motion error, drift is the cumulative error after the last frame.\n");
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+# Standalone stabilizer benchmark, runs headless without any input files.
+# qmake benchmark.pro && make && ./stabilizer-benchmark --help
+
+TARGET = stabilizer-benchmark
+TEMPLATE = app
+
+CONFIG += console c++11 warn_on
+CONFIG -= app_bundle
+QT += core gui opengl
+
+INCLUDEPATH += ../src
+
+unix {
+    LIBS += -lopencv_core -lopencv_imgproc -lopencv_highgui -lopencv_video
+
+    TEMP_CXX = $$(CXX)
+    !isEmpty(TEMP_CXX) { QMAKE_CXX = $$TEMP_CXX }
+}
+
+win32 {
+    INCLUDEPATH += ../include
+    QMAKE_LIBDIR += ../lib
+
+    CONFIG(debug, debug|release) {
+        LIBS += opencv_core249d.lib opencv_imgproc249d.lib opencv_highgui249d.lib opencv_video249d.lib
+    } else {
+        LIBS += opencv_core249.lib opencv_imgproc249.lib opencv_highgui249.lib opencv_video249.lib
+    }
+}
+
+mac {
+    LIBS += -lopencv_core -lopencv_imgproc -lopencv_highgui -lopencv_video
+
+    QMAKE_CXXFLAGS += -isystem /usr/local/include
+    QMAKE_LFLAGS += -L/usr/local/lib
+}
+
+OBJECTS_DIR = build
+MOC_DIR = build
+
+HEADERS += \
+    ../src/MovingAverage.h \
+    ../src/VideoStabilizer.h
+
+SOURCES += \
+    StabilizerBenchmark.cpp \
+    ../src/MovingAverage.cpp \
+    ../src/VideoStabilizer.cpp
@@ -0,0 +1,50 @@
+#version 120
+
+// Converts the rendered frame to I420 (BT.709, limited range) in a single channel target of width x height * 1.5.
+// Rows [0, height) are the Y plane, the next height / 4 rows are the U plane and the last height / 4 rows the V plane.
+// Each chroma row holds two chroma lines of width / 2, which matches the tightly packed plane layout in memory.
+
+uniform sampler2D textureSampler;
+uniform float textureWidth;
+uniform float textureHeight;
+
+const vec3 lumaWeights = vec3(0.2126, 0.7152, 0.0722);
+
+vec3 fetch(vec2 pixel)
+{
+	return texture2D(textureSampler, pixel / vec2(textureWidth, textureHeight)).rgb;
+}
+
+void main()
+{
+	vec2 position = floor(gl_FragCoord.xy);
+	float value = 0.0;
+
+	if (position.y < textureHeight)
+	{
+		float luma = dot(fetch(position + 0.5), lumaWeights);
+		value = (16.0 + 219.0 * luma) / 255.0;
+	}
+	else
+	{
+		float planeRows = textureHeight / 4.0;
+		float halfWidth = textureWidth / 2.0;
+		float row = position.y - textureHeight;
+		bool isV = (row >= planeRows);
+
+		if (isV)
+			row -= planeRows;
+
+		float chromaX = mod(position.x, halfWidth);
+		float chromaY = row * 2.0 + ((position.x >= halfWidth) ? 1.0 : 0.0);
+
+		// left chroma siting: co-sited with the even luma column (1 2 1 filter), centered between the two luma rows (linear filter)
+		vec2 center = vec2(chromaX * 2.0 + 0.5, chromaY * 2.0 + 1.0);
+		vec3 color = 0.25 * fetch(center - vec2(1.0, 0.0)) + 0.5 * fetch(center) + 0.25 * fetch(center + vec2(1.0, 0.0));
+		float luma = dot(color, lumaWeights);
+		float chroma = isV ? (color.r - luma) / 1.5748 : (color.b - luma) / 1.8556;
+		value = (128.0 + 224.0 * chroma) / 255.0;
+	}
+
+	gl_FragColor = vec4(value, value, value, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 120
+
+// Both the atlas and the tint are premultiplied.
+
+uniform sampler2D textureSampler;
+
+varying vec2 textureCoordinate;
+varying vec4 tintColor;
+
+void main()
+{
+	gl_FragColor = texture2D(textureSampler, textureCoordinate) * tintColor;
+}
@@ -0,0 +1,19 @@
+#version 120
+
+// Info panel quads are in window pixels, the background and the value glyphs all come from one atlas texture.
+
+uniform mat4 vertexMatrix;
+
+attribute vec2 vertexPosition;
+attribute vec2 vertexTextureCoordinate;
+attribute vec4 vertexColor;
+
+varying vec2 textureCoordinate;
+varying vec4 tintColor;
+
+void main()
+{
+	gl_Position = vertexMatrix * vec4(vertexPosition, 0.0, 1.0);
+	textureCoordinate = vertexTextureCoordinate;
+	tintColor = vertexColor;
+}
@@ -0,0 +1,12 @@
+#version 120
+
+// The resolved overlay is premultiplied.
+
+uniform sampler2D textureSampler;
+
+varying vec2 textureCoordinate;
+
+void main()
+{
+	gl_FragColor = texture2D(textureSampler, textureCoordinate);
+}
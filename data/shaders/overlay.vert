@@ -0,0 +1,15 @@
+#version 120
+
+// Covers the left part of the frame given by the overlay size, the overlay texture is the size of the whole frame.
+
+uniform vec2 overlaySize;
+
+attribute vec2 vertexPosition;
+
+varying vec2 textureCoordinate;
+
+void main()
+{
+	textureCoordinate = vertexPosition * overlaySize;
+	gl_Position = vec4(textureCoordinate * 2.0 - 1.0, 0.0, 1.0);
+}
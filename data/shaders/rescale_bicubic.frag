@@ -1,120 +1,54 @@
 #version 330
 
 uniform sampler2D textureSampler;
+uniform sampler2D weightSampler;
 uniform float textureWidth;
 uniform float textureHeight;
 uniform float texelWidth;
 uniform float texelHeight;
+uniform float weightCount;
+uniform float maxLod;
 
 in vec2 textureCoordinate;
 
 out vec3 color;
 
-// select one
-// triangle, bell, bspline, catmullrom, lanczos
-#define INTERPOLATION_FUNCTION lanczos
-
-// can be tuned (1.0f - 3.0f)
-#define LANCZOS_SIZE 2.0f
+// the interpolation function (triangle, bell, bspline, catmullrom or lanczos) is selected in the settings
+// and its weights over 0.0f - X_RANGE are precomputed into weightSampler
 
 // don't touch
-#define PI 3.14159265f
-#define SINC(x) (sin(PI * (x)) / (PI * (x)))
 #define X_RANGE 2.0f
 
-float triangle(float x)
-{
-	x = x / X_RANGE;
-	
-	if(x <= 0.0f)
-		return (x + 1.0f);
-	else
-		return (1.0f - x);
-}
-
-float bell(float x)
-{
-	x = (x / X_RANGE) * 1.5f;
-	
-	if(x >= -1.5f && x <= -0.5f)
-	{
-		return(0.5f * pow(x + 1.5f, 2.0f));
-	}
-	else if(x > -0.5f && x <= 0.5f)
-	{
-		return 3.0f / 4.0f - (x * x);
-	}
-	else if(x > 0.5f && x <= 1.5f)
-	{
-		return(0.5f * pow(x - 1.5f, 2.0f));
-	}
-	else
-		return 0.0f;
-}
-
-float bspline(float x)
+float interpolationWeight(float x)
 {
-	x = (abs(x) / X_RANGE) * 2.0f;
-
-	if(x >= 0.0f && x <= 1.0f)
-	{
-		return (2.0f / 3.0f) + 0.5f * (x * x * x) - (x * x);
-	}
-	else if(x > 1.0f && x <= 2.0f)
-	{
-		return (1.0f / 6.0f) * pow(2.0f - x, 3.0f);
-	}
-	else
-		return 0.0f;
-}  
-
-float catmullrom(float x)
-{
-    const float B = 0.0f;
-    const float C = 0.5f;
-    
-    x = (abs(x) / X_RANGE) * 2.0f;
-    
-	if(x < 1.0f)
-	{
-		return ((12 - 9 * B - 6 * C) * (x * x * x) +
-		(-18 + 12 * B + 6 * C) * (x * x) +
-		(6 - 2 * B)) / 6.0f;
-	}
-	else if(x >= 1.0f && x <= 2.0f)
-	{
-		return ((-B - 6 * C) * (x * x * x) +
-		(6 * B + 30 * C) * (x * x) +
-		(-12 * B - 48 * C) * x +
-		8 * B + 24 * C) / 6.0f;
-	}
-	else
-		return 0.0f;
+	float t = min(abs(x) / X_RANGE, 1.0f);
+	return texture(weightSampler, vec2((t * (weightCount - 1.0f) + 0.5f) / weightCount, 0.5f)).r;
 }
 
-float lanczos(float x)
+void main()
 {
-	x = (abs(x) / X_RANGE) * LANCZOS_SIZE;
+	// pick the mip level from the screen space footprint, the snapped coordinates below have no usable derivatives
+	// the filter then runs on that level's texels, levels above maxLod don't exist
+	vec2 dx = dFdx(textureCoordinate * vec2(textureWidth, textureHeight));
+	vec2 dy = dFdy(textureCoordinate * vec2(textureWidth, textureHeight));
+	float lod = clamp(floor(0.5f * log2(max(dot(dx, dx), dot(dy, dy)))), 0.0f, maxLod);
 
-	if (x == 0.0f)
-		return 1.0f;
-	else
-		return SINC(x) * SINC(x / LANCZOS_SIZE);
-}
+	float levelWidth = max(1.0f, floor(textureWidth / exp2(lod)));
+	float levelHeight = max(1.0f, floor(textureHeight / exp2(lod)));
+	float levelTexelWidth = 1.0f / levelWidth;
+	float levelTexelHeight = 1.0f / levelHeight;
 
-void main()
-{
 	// round up to the nearest texel center (this avoids hardware bilinear)
-	float tx = textureCoordinate.x * textureWidth;
+	float tx = textureCoordinate.x * levelWidth;
 	tx = ceil(tx + 0.5f) - 0.5f;
 
-	float ty = textureCoordinate.y * textureHeight;
+	float ty = textureCoordinate.y * levelHeight;
 	ty = ceil(ty + 0.5f) - 0.5f;
 
-	vec2 snappedTextureCoordinate = vec2(tx / textureWidth, ty / textureHeight);
+	vec2 snappedTextureCoordinate = vec2(tx / levelWidth, ty / levelHeight);
 	
-	float alphaX = fract(textureCoordinate.x * textureWidth);
-	float alphaY = fract(textureCoordinate.y * textureHeight);
+	float alphaX = fract(textureCoordinate.x * levelWidth);
+	float alphaY = fract(textureCoordinate.y * levelHeight);
 	
 	// remap alpha 0.5 1.0 0.5 -> 0.0 0.5 1.0
 	// the snapping makes this necessary
@@ -128,10 +62,10 @@ void main()
 	{
 		for(int y = -1; y <= 2; y++)
 		{
-			vec4 color = texture(textureSampler, snappedTextureCoordinate + vec2(texelWidth * float(x), texelHeight * float(y)));
+			vec4 color = textureLod(textureSampler, snappedTextureCoordinate + vec2(levelTexelWidth * float(x), levelTexelHeight * float(y)), lod);
 				
-			float f1 = INTERPOLATION_FUNCTION(float(x) - alphaX); // argument range is -2.0f - 2.0f
-			float f2 = INTERPOLATION_FUNCTION((float(y) - alphaY));  // argument range is -2.0f - 2.0f
+			float f1 = interpolationWeight(float(x) - alphaX); // argument range is -2.0f - 2.0f
+			float f2 = interpolationWeight((float(y) - alphaY));  // argument range is -2.0f - 2.0f
 			vec4 f1vec = vec4(f1, f1, f1, f1);
 			vec4 f2vec = vec4(f2, f2, f2, f2);
 			vec4 combined = f1vec * f2vec;
@@ -0,0 +1,44 @@
+#version 330
+
+// First pass of the separable rescale: every row of the source is resampled to the output width.
+// TAP_COUNT is defined by the renderer, which keeps one compiled variant per tap count.
+
+uniform sampler2D textureSampler;
+uniform sampler2D weightSampler;
+uniform float weightCount;
+uniform float sourceWidth;
+uniform float targetWidth;
+uniform float filterScale;
+
+out vec4 color;
+
+// don't touch
+#define X_RANGE 2.0f
+
+float interpolationWeight(float x)
+{
+	float t = min(abs(x) / X_RANGE, 1.0f);
+	return texture(weightSampler, vec2((t * (weightCount - 1.0f) + 0.5f) / weightCount, 0.5f)).r;
+}
+
+void main()
+{
+	// output pixel centre in source texel units, the filter is stretched by filterScale when shrinking
+	float sourceX = gl_FragCoord.x * sourceWidth / targetWidth - 0.5f;
+	int firstTexel = int(floor(sourceX)) - TAP_COUNT / 2 + 1;
+	int lastTexel = int(sourceWidth) - 1;
+	int y = int(gl_FragCoord.y);
+
+	vec4 num = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	float den = 0.0f;
+
+	for (int i = 0; i < TAP_COUNT; i++)
+	{
+		float weight = interpolationWeight((float(firstTexel + i) - sourceX) / filterScale);
+
+		num += texelFetch(textureSampler, ivec2(clamp(firstTexel + i, 0, lastTexel), y), 0) * weight;
+		den += weight;
+	}
+
+	color = num / den;
+}
@@ -0,0 +1,44 @@
+#version 330
+
+// Second pass of the separable rescale: the rows are already at the output width, so only the columns are
+// filtered here while the panel is drawn. TAP_COUNT is defined by the renderer like in the first pass.
+
+uniform sampler2D textureSampler;
+uniform sampler2D weightSampler;
+uniform float weightCount;
+uniform float textureHeight;
+uniform float filterScale;
+
+in vec2 textureCoordinate;
+
+out vec3 color;
+
+// don't touch
+#define X_RANGE 2.0f
+
+float interpolationWeight(float x)
+{
+	float t = min(abs(x) / X_RANGE, 1.0f);
+	return texture(weightSampler, vec2((t * (weightCount - 1.0f) + 0.5f) / weightCount, 0.5f)).r;
+}
+
+void main()
+{
+	float sourceY = textureCoordinate.y * textureHeight - 0.5f;
+	int firstTexel = int(floor(sourceY)) - TAP_COUNT / 2 + 1;
+
+	vec4 num = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	float den = 0.0f;
+
+	for (int i = 0; i < TAP_COUNT; i++)
+	{
+		float texelY = clamp(float(firstTexel + i), 0.0f, textureHeight - 1.0f);
+		float weight = interpolationWeight((float(firstTexel + i) - sourceY) / filterScale);
+
+		// horizontally the intermediate is close to one texel per pixel, so the hardware filter is enough there
+		num += texture(textureSampler, vec2(textureCoordinate.x, (texelY + 0.5f) / textureHeight)) * weight;
+		den += weight;
+	}
+
+	color = (num / den).rgb;
+}
@@ -21,11 +21,15 @@ void main()
 
 	vec2 snappedTextureCoordinate = vec2(tx / textureWidth, ty / textureHeight);
 
+	// the snapped coordinates jump at texel edges, so the mip level comes from the unsnapped ones
+	vec2 dx = dFdx(textureCoordinate);
+	vec2 dy = dFdy(textureCoordinate);
+
 	// take color samples from four nearest texel centers
-	vec4 tl = texture(textureSampler, snappedTextureCoordinate);
-	vec4 tr = texture(textureSampler, snappedTextureCoordinate + vec2(texelWidth, 0));
-	vec4 bl = texture(textureSampler, snappedTextureCoordinate + vec2(0, texelHeight));
-	vec4 br = texture(textureSampler, snappedTextureCoordinate + vec2(texelWidth, texelHeight));
+	vec4 tl = textureGrad(textureSampler, snappedTextureCoordinate, dx, dy);
+	vec4 tr = textureGrad(textureSampler, snappedTextureCoordinate + vec2(texelWidth, 0), dx, dy);
+	vec4 bl = textureGrad(textureSampler, snappedTextureCoordinate + vec2(0, texelHeight), dx, dy);
+	vec4 br = textureGrad(textureSampler, snappedTextureCoordinate + vec2(texelWidth, texelHeight), dx, dy);
 
 	float alphaX = fract(textureCoordinate.x * textureWidth);
 	float alphaY = fract(textureCoordinate.y * textureHeight);
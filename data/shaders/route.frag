@@ -0,0 +1,31 @@
+#version 120
+
+// Segments are rectangles with the shape coordinate running across the line, joins and caps are quads around each
+// route point with the shape coordinate running out from the centre. The distance to the centre line is then simply
+// the length of the shape coordinate, which gives round joins and caps and an antialiased edge one pixel wide.
+// The interior is drawn first and marks the stencil so that overlapping pieces don't blend twice, the edges follow.
+
+uniform vec4 routeColor;
+uniform float paceAmount;
+uniform float innerRadius; // relative to the half width, above zero the points are cut to rings
+uniform bool edgePass;
+
+varying vec2 shapeCoordinate;
+varying vec4 paceColor;
+
+void main()
+{
+	float distance = length(shapeCoordinate);
+	float coverage = clamp((1.0 - distance) / max(fwidth(distance), 0.0001), 0.0, 1.0);
+
+	if (innerRadius > 0.0)
+		coverage = min(coverage, clamp((distance - innerRadius) / max(fwidth(distance), 0.0001), 0.0, 1.0));
+
+	if (coverage <= 0.0 || (coverage < 1.0) != edgePass)
+		discard;
+
+	vec4 color = mix(routeColor, paceColor, paceAmount);
+	float alpha = color.a * coverage;
+
+	gl_FragColor = vec4(color.rgb * alpha, alpha);
+}
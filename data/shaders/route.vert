@@ -0,0 +1,22 @@
+#version 120
+
+// Route geometry is stored in map pixels. Each vertex is pushed out from the route centre line by offset * halfWidth,
+// so the same vertex buffer works for any route width and zoom level.
+
+uniform mat4 vertexMatrix;
+uniform float halfWidth;
+
+attribute vec2 vertexPosition;
+attribute vec2 vertexOffset;
+attribute vec2 vertexShapeCoordinate;
+attribute vec4 vertexColor;
+
+varying vec2 shapeCoordinate;
+varying vec4 paceColor;
+
+void main()
+{
+	gl_Position = vertexMatrix * vec4(vertexPosition + vertexOffset * halfWidth, 0.0, 1.0);
+	shapeCoordinate = vertexShapeCoordinate;
+	paceColor = vertexColor;
+}
@@ -31,7 +31,7 @@ win32 {
     INCLUDEPATH += include
     QMAKE_LIBDIR += lib
 
-    LIBS += avformat.lib avutil.lib avcodec.lib swscale.lib libx264.dll.lib liblsmash.lib
+    LIBS += avformat.lib avutil.lib avcodec.lib swscale.lib libx264.dll.lib liblsmash.lib winmm.lib
 
     CONFIG(debug, debug|release) {
         LIBS += opencv_core249d.lib opencv_imgproc249d.lib opencv_photo249d.lib opencv_video249d.lib
@@ -66,10 +66,14 @@ UI_DIR = build
 HEADERS  += \
     src/EncodeWindow.h \
     src/FrameData.h \
+    src/FramePacer.h \
+    src/GpuTimer.h \
     src/GpxReader.h \
+    src/InfoPanel.h \
     src/InputHandler.h \
     src/MainWindow.h \
     src/MapImageReader.h \
+    src/MapTileManager.h \
     src/MovingAverage.h \
     src/Mp4File.h \
     src/QuickRouteReader.h \
@@ -79,9 +83,13 @@ HEADERS  += \
     src/RouteManager.h \
     src/RoutePoint.h \
     src/Settings.h \
+    src/ShaderCache.h \
     src/SimpleLogger.h \
+    src/SoftwareCompositor.h \
     src/SplitsManager.h \
+    src/StabilizerCache.h \
     src/StabilizeWindow.h \
+    src/TelemetryReader.h \
     src/VideoDecoder.h \
     src/VideoDecoderThread.h \
     src/VideoEncoder.h \
@@ -92,11 +100,15 @@ HEADERS  += \
 
 SOURCES += \
     src/EncodeWindow.cpp \
+    src/FramePacer.cpp \
+    src/GpuTimer.cpp \
     src/GpxReader.cpp \
+    src/InfoPanel.cpp \
     src/InputHandler.cpp \
     src/Main.cpp \
     src/MainWindow.cpp \
     src/MapImageReader.cpp \
+    src/MapTileManager.cpp \
     src/MovingAverage.cpp \
     src/Mp4File.cpp \
     src/QuickRouteReader.cpp \
@@ -105,9 +117,13 @@ SOURCES += \
     src/RenderOnScreenThread.cpp \
     src/RouteManager.cpp \
     src/Settings.cpp \
+    src/ShaderCache.cpp \
     src/SimpleLogger.cpp \
+    src/SoftwareCompositor.cpp \
     src/SplitsManager.cpp \
+    src/StabilizerCache.cpp \
     src/StabilizeWindow.cpp \
+    src/TelemetryReader.cpp \
     src/VideoDecoder.cpp \
     src/VideoDecoderThread.cpp \
     src/VideoEncoder.cpp \
@@ -21,18 +21,7 @@ EncodeWindow::EncodeWindow(QWidget *parent) : QDialog(parent), ui(new Ui::Encode
 
 EncodeWindow::~EncodeWindow()
 {
-	if (context != nullptr)
-	{
-		delete context;
-		context = nullptr;
-	}
-
-	if (surface != nullptr)
-	{
-		surface->destroy();
-		delete surface;
-		surface = nullptr;
-	}
+	deleteContext();
 
 	if (ui != nullptr)
 	{
@@ -50,6 +39,34 @@ bool EncodeWindow::initialize(VideoDecoder* videoDecoder, VideoEncoderThread* vi
 	setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
 	resize(10, 10);
 
+	// without a context the renderer composites the frames on the CPU
+	if (settings->renderer.useSoftwareRendering)
+		qDebug("Software rendering selected, not creating an OpenGL context");
+	else if (!createContext(settings))
+	{
+		qWarning("Could not set up OpenGL, falling back to software rendering");
+		deleteContext();
+	}
+
+	totalFrameCount = videoDecoder->getTotalFrameCount();
+	videoFilePath = settings->encoder.outputVideoFilePath;
+
+	QTime totalVideoDuration = QTime(0, 0, 0, 0).addMSecs(videoDecoder->getTotalDuration() * 1000.0);
+
+	ui->progressBarMain->setValue(0);
+	ui->labelTotalVideoDuration->setText(totalVideoDuration.toString());
+	ui->labelTotalFrames->setText(QString::number(totalFrameCount));
+	ui->pushButtonOpen->setEnabled(false);
+
+	startTime.start();
+
+	isInitialized = true;
+
+	return true;
+}
+
+bool EncodeWindow::createContext(Settings* settings)
+{
 	QSurfaceFormat surfaceFormat;
 	surfaceFormat.setSamples(settings->window.multisamples);
 
@@ -78,21 +95,23 @@ bool EncodeWindow::initialize(VideoDecoder* videoDecoder, VideoEncoderThread* vi
 		return false;
 	}
 
-	totalFrameCount = videoDecoder->getTotalFrameCount();
-	videoFilePath = settings->encoder.outputVideoFilePath;
-
-	QTime totalVideoDuration = QTime(0, 0, 0, 0).addMSecs(videoDecoder->getTotalDuration() * 1000.0);
-
-	ui->progressBarMain->setValue(0);
-	ui->labelTotalVideoDuration->setText(totalVideoDuration.toString());
-	ui->labelTotalFrames->setText(QString::number(totalFrameCount));
-	ui->pushButtonOpen->setEnabled(false);
-
-	startTime.start();
+	return true;
+}
 
-	isInitialized = true;
+void EncodeWindow::deleteContext()
+{
+	if (context != nullptr)
+	{
+		delete context;
+		context = nullptr;
+	}
 
-	return true;
+	if (surface != nullptr)
+	{
+		surface->destroy();
+		delete surface;
+		surface = nullptr;
+	}
 }
 
 QOffscreenSurface* EncodeWindow::getSurface() const
@@ -53,6 +53,8 @@ namespace OrientView
 	private:
 
 		bool event(QEvent* event);
+		bool createContext(Settings* settings);
+		void deleteContext();
 
 		Ui::EncodeWindow* ui = nullptr;
 		VideoEncoderThread* videoEncoderThread = nullptr;
@@ -18,5 +18,6 @@ namespace OrientView
 		int64_t duration = 0;			// Duration in microseconds
 		int64_t timeStamp = 0;			// Time stamp given by FFmpeg (no unit)
 		int64_t cumulativeNumber = 0;	// Total number of frames produced (doesn't reset on seek)
+		bool isPlanarYuv = false;		// Data is tightly packed I420 planes (Y, U, V) instead of packed pixels
 	};
 }
@@ -0,0 +1,152 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#include <QThread>
+
+#ifdef Q_OS_WIN32
+#include <windows.h>
+#endif
+
+#include "FramePacer.h"
+
+using namespace OrientView;
+
+namespace
+{
+	// the OS sleep can overshoot by about a timer tick, the rest is yielded away
+	const int64_t sleepMargin = 1000;
+
+	// further behind than this the schedule starts over instead of rushing the frames out to catch up
+	const int64_t maxLag = 250000;
+}
+
+void FramePacer::initialize(double refreshRate, int swapInterval)
+{
+	qDebug("Initializing frame pacer");
+
+	refreshPeriod = (refreshRate > 0.0) ? (int64_t)(1000000.0 / refreshRate) : 16667;
+
+	// with vsync the swap shows the frame at the next refresh, so swapping half a refresh early lands on the closest one
+	presentationLead = (swapInterval > 0) ? (refreshPeriod * swapInterval / 2) : 0;
+
+#ifdef Q_OS_WIN32
+	isHighResolutionTimerEnabled = (timeBeginPeriod(1) == TIMERR_NOERROR);
+#endif
+
+	clock.start();
+	reset();
+
+	presentedFrameCount = 0;
+	lateFrameCount = 0;
+	droppedFrameCount = 0;
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef Q_OS_WIN32
+	if (isHighResolutionTimerEnabled)
+		timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::reset()
+{
+	isScheduled = false;
+	isRestarted = false;
+	deadline = 0;
+	previousFrameDuration = 0;
+}
+
+void FramePacer::scheduleFrame(int64_t frameDuration)
+{
+	int64_t now = getTime();
+
+	// each deadline is the previous one plus the previous frame's duration, never measured from the current time
+	if (!isScheduled)
+	{
+		deadline = now;
+		isScheduled = true;
+		isRestarted = true;
+	}
+	else
+		deadline += previousFrameDuration;
+
+	previousFrameDuration = frameDuration;
+
+	int64_t lag = now - deadline;
+
+	if (lag > maxLag)
+	{
+		droppedFrameCount += (frameDuration > 0) ? (lag / frameDuration) : 0;
+		deadline = now;
+		isRestarted = true;
+	}
+}
+
+double FramePacer::waitForPresentation()
+{
+	int64_t now = getTime();
+
+	// a restarted schedule has its deadline at the time it was scheduled, so its first frame is shown right away and not counted late
+	if (isRestarted)
+	{
+		isRestarted = false;
+		presentedFrameCount++;
+
+		return 0.0;
+	}
+
+	double spareTime = (deadline - now) / 1000.0;
+
+	// checked at the swap, so that frames whose rendering ran past the deadline are counted too
+	if (now > deadline - presentationLead)
+		lateFrameCount++;
+
+	sleepUntil(deadline - presentationLead);
+	presentedFrameCount++;
+
+	return spareTime;
+}
+
+void FramePacer::waitForIdleFrame()
+{
+	// without vsync nothing would stop a paused player from redrawing as fast as it can
+	if (presentationLead == 0)
+		sleepUntil(getTime() + refreshPeriod);
+}
+
+int64_t FramePacer::getPresentedFrameCount() const
+{
+	return presentedFrameCount;
+}
+
+int64_t FramePacer::getLateFrameCount() const
+{
+	return lateFrameCount;
+}
+
+int64_t FramePacer::getDroppedFrameCount() const
+{
+	return droppedFrameCount;
+}
+
+int64_t FramePacer::getTime() const
+{
+	return clock.nsecsElapsed() / 1000;
+}
+
+void FramePacer::sleepUntil(int64_t time) const
+{
+	while (true)
+	{
+		int64_t timeToSleep = time - getTime();
+
+		if (timeToSleep <= 0)
+			break;
+
+		if (timeToSleep > sleepMargin)
+			QThread::usleep(timeToSleep - sleepMargin);
+		else
+			QThread::yieldCurrentThread();
+	}
+}
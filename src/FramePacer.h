@@ -0,0 +1,49 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+
+#include <QElapsedTimer>
+
+namespace OrientView
+{
+	// Schedule frame presentation on absolute deadlines so that the timing doesn't drift.
+	class FramePacer
+	{
+
+	public:
+
+		void initialize(double refreshRate, int swapInterval);
+		~FramePacer();
+
+		void reset();
+		void scheduleFrame(int64_t frameDuration);
+		double waitForPresentation();
+		void waitForIdleFrame();
+
+		int64_t getPresentedFrameCount() const;
+		int64_t getLateFrameCount() const;
+		int64_t getDroppedFrameCount() const;
+
+	private:
+
+		int64_t getTime() const;
+		void sleepUntil(int64_t time) const;
+
+		QElapsedTimer clock;
+		int64_t refreshPeriod = 0;
+		int64_t presentationLead = 0;
+		bool isHighResolutionTimerEnabled = false;
+
+		bool isScheduled = false;
+		bool isRestarted = false;
+		int64_t deadline = 0;
+		int64_t previousFrameDuration = 0;
+
+		int64_t presentedFrameCount = 0;
+		int64_t lateFrameCount = 0;
+		int64_t droppedFrameCount = 0;
+	};
+}
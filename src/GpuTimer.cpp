@@ -0,0 +1,157 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#include "GpuTimer.h"
+
+using namespace OrientView;
+
+namespace
+{
+	const char* passNames[GpuTimer::passCount] = { "video", "map", "route", "info_panel", "resolve", "readback" };
+}
+
+bool GpuTimer::initialize(const QString& logFilePath)
+{
+	for (int i = 0; i < passCount; ++i)
+	{
+		intervalCounts[i][0] = intervalCounts[i][1] = 0;
+		isStale[i] = false;
+		isRunning[i] = false;
+		isMeasured[i] = false;
+		frameDurations[i] = -1.0;
+		averageDurations[i].setAlpha(0.005);
+	}
+
+	isTimerAvailable = true;
+
+	// needs OpenGL 3.3 or ARB_timer_query
+	for (int i = 0; i < passCount && isTimerAvailable; ++i)
+	{
+		for (int j = 0; j < maxIntervalCount && isTimerAvailable; ++j)
+			isTimerAvailable = queries[i][0][j].create() && queries[i][1][j].create();
+	}
+
+	if (!isTimerAvailable)
+	{
+		qWarning("Timer queries are not available, GPU pass durations are not measured");
+		return false;
+	}
+
+	if (!logFilePath.isEmpty())
+	{
+		logFile.setFileName(logFilePath);
+
+		if (!logFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+			qWarning("Could not open GPU timing log file %s", qPrintable(logFilePath));
+		else
+		{
+			QString header = "frame";
+
+			for (int i = 0; i < passCount; ++i)
+				header += QString(";%1").arg(passNames[i]);
+
+			logFile.write(QString("%1\n").arg(header).toLatin1());
+		}
+	}
+
+	return true;
+}
+
+GpuTimer::~GpuTimer()
+{
+	if (logFile.isOpen())
+		logFile.close();
+}
+
+void GpuTimer::startFrame()
+{
+	if (!isTimerAvailable)
+		return;
+
+	queryIndex = 1 - queryIndex;
+	frameNumber++;
+
+	// the slots about to be reused were issued two frames ago, so their results are normally ready without stalling
+	bool hasResults = false;
+
+	for (int i = 0; i < passCount; ++i)
+	{
+		frameDurations[i] = -1.0;
+
+		int intervalCount = intervalCounts[i][queryIndex];
+
+		// the parts finish in order, so the last one being ready means they all are
+		if (intervalCount > 0 && queries[i][queryIndex][intervalCount - 1].isResultAvailable())
+		{
+			frameDurations[i] = 0.0;
+
+			for (int j = 0; j < intervalCount; ++j)
+				frameDurations[i] += queries[i][queryIndex][j].waitForResult() / 1000000.0;
+
+			averageDurations[i].addMeasurement(frameDurations[i]);
+			intervalCounts[i][queryIndex] = 0;
+			isMeasured[i] = true;
+			hasResults = true;
+		}
+
+		isStale[i] = (intervalCounts[i][queryIndex] > 0);
+	}
+
+	if (hasResults && logFile.isOpen())
+		writeLogLine();
+}
+
+void GpuTimer::begin(GpuTimerPass pass)
+{
+	int passIndex = (int)pass;
+
+	// a slot whose result still isn't ready is skipped for this frame
+	if (!isTimerAvailable || isStale[passIndex] || intervalCounts[passIndex][queryIndex] >= maxIntervalCount)
+		return;
+
+	queries[passIndex][queryIndex][intervalCounts[passIndex][queryIndex]].begin();
+	isRunning[passIndex] = true;
+}
+
+void GpuTimer::end(GpuTimerPass pass)
+{
+	int passIndex = (int)pass;
+
+	if (!isRunning[passIndex])
+		return;
+
+	queries[passIndex][queryIndex][intervalCounts[passIndex][queryIndex]].end();
+	isRunning[passIndex] = false;
+	intervalCounts[passIndex][queryIndex]++;
+}
+
+bool GpuTimer::isAvailable() const
+{
+	return isTimerAvailable;
+}
+
+bool GpuTimer::hasMeasurement(GpuTimerPass pass) const
+{
+	return isMeasured[(int)pass];
+}
+
+double GpuTimer::getAverageDuration(GpuTimerPass pass) const
+{
+	return averageDurations[(int)pass].getAverage();
+}
+
+void GpuTimer::writeLogLine()
+{
+	// the results belong to the frame that issued them, passes that didn't run are left empty
+	QString line = QString::number(frameNumber - 2);
+
+	for (int i = 0; i < passCount; ++i)
+	{
+		line += ";";
+
+		if (frameDurations[i] >= 0.0)
+			line += QString::number(frameDurations[i], 'f', 3);
+	}
+
+	logFile.write(QString("%1\n").arg(line).toLatin1());
+}
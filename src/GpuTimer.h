@@ -0,0 +1,58 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+
+#include <QFile>
+#include <QOpenGLTimerQuery>
+#include <QString>
+
+#include "MovingAverage.h"
+
+namespace OrientView
+{
+	enum class GpuTimerPass { VideoPanel, MapPanel, Route, InfoPanel, Resolve, Readback };
+
+	// Measure the render passes on the GPU with timer queries that are read back two frames later.
+	// A pass can be measured in a few separate parts per frame, the parts are added together.
+	class GpuTimer
+	{
+
+	public:
+
+		static const int passCount = 6;
+
+		bool initialize(const QString& logFilePath);
+		~GpuTimer();
+
+		void startFrame();
+		void begin(GpuTimerPass pass);
+		void end(GpuTimerPass pass);
+
+		bool isAvailable() const;
+		bool hasMeasurement(GpuTimerPass pass) const;
+		double getAverageDuration(GpuTimerPass pass) const;
+
+	private:
+
+		static const int maxIntervalCount = 4;
+
+		void writeLogLine();
+
+		QOpenGLTimerQuery queries[passCount][2][maxIntervalCount];
+		int intervalCounts[passCount][2] = {};
+		bool isStale[passCount] = {};
+		bool isRunning[passCount] = {};
+		bool isMeasured[passCount] = {};
+		double frameDurations[passCount] = {};
+		MovingAverage averageDurations[passCount];
+
+		bool isTimerAvailable = false;
+		int queryIndex = 0;
+		int64_t frameNumber = 0;
+
+		QFile logFile;
+	};
+}
@@ -0,0 +1,218 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#include <algorithm>
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QPainter>
+
+#include "InfoPanel.h"
+
+using namespace OrientView;
+
+namespace
+{
+	const int firstGlyph = 32;
+	const int lastGlyph = 126;
+	const int glyphPadding = 1; // room for antialiased pixels outside the advance
+	const int minimumAtlasWidth = 256;
+}
+
+bool InfoPanel::initialize(int fontSize, const std::vector<QString>& labels)
+{
+	QFont font = QFont("DejaVu Sans", fontSize, QFont::Bold);
+	QFontMetrics metrics(font);
+
+	int textX = 10;
+	textY = 6;
+	lineHeight = metrics.height();
+	lineSpacing = metrics.lineSpacing() + 1;
+	int lineWidth1 = 0;
+	int lineWidth2 = metrics.boundingRect("99:99:99.999").width();
+	int rightPartMargin = 15;
+	int backgroundRadius = 10;
+
+	for (const QString& label : labels)
+		lineWidth1 = std::max(lineWidth1, metrics.boundingRect(label).width());
+
+	int backgroundWidth = textX + backgroundRadius + lineWidth1 + rightPartMargin + lineWidth2 + 10;
+	int backgroundHeight = lineSpacing * ((int)labels.size() + 1) + textY + 3;
+
+	valueX = textX + lineWidth1 + rightPartMargin;
+
+	// the background starts outside the window, so only the visible part plus the border stroke is kept
+	panelRect = QRect(0, 0, backgroundWidth - backgroundRadius + 1, backgroundHeight - backgroundRadius + 1);
+
+	int atlasWidth = std::max(panelRect.width(), minimumAtlasWidth);
+	int glyphX = 0;
+	int glyphY = panelRect.height() + 1;
+
+	for (int i = firstGlyph; i <= lastGlyph; ++i)
+	{
+		glyphs[i].advance = metrics.width(QChar(i));
+		int cellWidth = glyphs[i].advance + 2 * glyphPadding;
+
+		if (glyphX + cellWidth > atlasWidth)
+		{
+			glyphX = 0;
+			glyphY += lineHeight + 1;
+		}
+
+		glyphs[i].atlasRect = QRect(glyphX, glyphY, cellWidth, lineHeight);
+		glyphX += cellWidth + 1;
+	}
+
+	atlasImage = QImage(atlasWidth, glyphY + lineHeight, QImage::Format_ARGB32_Premultiplied);
+
+	if (atlasImage.isNull())
+	{
+		qWarning("Could not create info panel atlas");
+		return false;
+	}
+
+	atlasImage.fill(Qt::transparent);
+
+	QPainter painter(&atlasImage);
+	painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::HighQualityAntialiasing);
+
+	painter.setClipRect(panelRect);
+	painter.setPen(QColor(0, 0, 0));
+	painter.setBrush(QBrush(QColor(20, 20, 20, 220)));
+	painter.drawRoundedRect(-backgroundRadius, -backgroundRadius, backgroundWidth, backgroundHeight, backgroundRadius, backgroundRadius);
+
+	painter.setPen(QColor(255, 255, 255, 200));
+	painter.setFont(font);
+
+	for (int i = 0; i < (int)labels.size(); ++i)
+		painter.drawText(textX, textY + i * lineSpacing, lineWidth1, lineHeight, 0, labels.at(i));
+
+	// glyphs are white and opaque, the vertex color gives them their final color
+	painter.setClipping(false);
+	painter.setPen(QColor(255, 255, 255));
+
+	for (int i = firstGlyph; i <= lastGlyph; ++i)
+	{
+		const QRect& atlasRect = glyphs[i].atlasRect;
+		painter.drawText(atlasRect.x() + glyphPadding, atlasRect.y(), glyphs[i].advance, lineHeight, 0, QString(QChar(i)));
+	}
+
+	painter.end();
+
+	rows.clear();
+	rows.resize(labels.size());
+	verticesChanged = true;
+
+	return true;
+}
+
+void InfoPanel::setValue(int row, const QString& text, const QColor& color)
+{
+	InfoPanelRow& infoPanelRow = rows.at(row);
+
+	if (infoPanelRow.text == text && infoPanelRow.color == color)
+		return;
+
+	infoPanelRow.text = text;
+	infoPanelRow.color = color;
+	verticesChanged = true;
+}
+
+bool InfoPanel::updateVertices()
+{
+	if (!verticesChanged)
+		return false;
+
+	vertices.clear();
+	addQuad(panelRect, panelRect, QColor(255, 255, 255));
+
+	for (int i = 0; i < (int)rows.size(); ++i)
+	{
+		int x = valueX;
+		int y = textY + i * lineSpacing;
+
+		for (QChar character : rows.at(i).text)
+		{
+			int index = character.unicode();
+
+			// outside the atlas, the same as an empty glyph
+			if (index < firstGlyph || index > lastGlyph)
+				index = ' ';
+
+			if (index != ' ')
+				addQuad(QRect(x - glyphPadding, y, glyphs[index].atlasRect.width(), lineHeight), glyphs[index].atlasRect, rows.at(i).color);
+
+			x += glyphs[index].advance;
+		}
+	}
+
+	verticesChanged = false;
+
+	return true;
+}
+
+void InfoPanel::paint(QPainter* painter) const
+{
+	painter->save();
+	painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+
+	// the tint only changes the color of the spare time row, which isn't shown when encoding, so only its alpha is kept here
+	for (size_t i = 0; i + 5 < vertices.size(); i += 6)
+	{
+		const InfoPanelVertex& topLeft = vertices.at(i);
+		const InfoPanelVertex& bottomRight = vertices.at(i + 2);
+
+		QRectF rect(topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y);
+		QRectF atlasRect(topLeft.u * atlasImage.width(), topLeft.v * atlasImage.height(), rect.width(), rect.height());
+
+		painter->setOpacity(topLeft.a);
+		painter->drawImage(rect, atlasImage, atlasRect);
+	}
+
+	painter->restore();
+}
+
+const QImage& InfoPanel::getAtlasImage() const
+{
+	return atlasImage;
+}
+
+const std::vector<InfoPanelVertex>& InfoPanel::getVertices() const
+{
+	return vertices;
+}
+
+void InfoPanel::addQuad(const QRect& rect, const QRect& atlasRect, const QColor& color)
+{
+	float x1 = rect.x();
+	float y1 = rect.y();
+	float x2 = rect.x() + rect.width();
+	float y2 = rect.y() + rect.height();
+	float u1 = (float)atlasRect.x() / atlasImage.width();
+	float v1 = (float)atlasRect.y() / atlasImage.height();
+	float u2 = (float)(atlasRect.x() + atlasRect.width()) / atlasImage.width();
+	float v2 = (float)(atlasRect.y() + atlasRect.height()) / atlasImage.height();
+
+	InfoPanelVertex vertex;
+	vertex.a = color.alphaF();
+	vertex.r = color.redF() * vertex.a;
+	vertex.g = color.greenF() * vertex.a;
+	vertex.b = color.blueF() * vertex.a;
+
+	// triangles 1 2 3 and 1 3 4, the software path reads the rectangle from the first and third vertex
+	// 1 2
+	// 4 3
+	InfoPanelVertex corners[4] = { vertex, vertex, vertex, vertex };
+
+	corners[0].x = x1; corners[0].y = y1; corners[0].u = u1; corners[0].v = v1;
+	corners[1].x = x2; corners[1].y = y1; corners[1].u = u2; corners[1].v = v1;
+	corners[2].x = x2; corners[2].y = y2; corners[2].u = u2; corners[2].v = v2;
+	corners[3].x = x1; corners[3].y = y2; corners[3].u = u1; corners[3].v = v2;
+
+	vertices.push_back(corners[0]);
+	vertices.push_back(corners[1]);
+	vertices.push_back(corners[2]);
+	vertices.push_back(corners[0]);
+	vertices.push_back(corners[2]);
+	vertices.push_back(corners[3]);
+}
@@ -0,0 +1,74 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#pragma once
+
+#include <vector>
+
+#include <QColor>
+#include <QImage>
+#include <QRect>
+#include <QString>
+
+class QPainter;
+
+namespace OrientView
+{
+	// Position in window pixels, atlas texture coordinate and premultiplied tint.
+	struct InfoPanelVertex
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float u = 0.0f;
+		float v = 0.0f;
+		float r = 1.0f;
+		float g = 1.0f;
+		float b = 1.0f;
+		float a = 1.0f;
+	};
+
+	struct InfoPanelGlyph
+	{
+		QRect atlasRect;
+		int advance = 0;
+	};
+
+	struct InfoPanelRow
+	{
+		QString text;
+		QColor color;
+	};
+
+	// Pre-rendered info panel background and labels with a glyph atlas for the changing values.
+	class InfoPanel
+	{
+
+	public:
+
+		bool initialize(int fontSize, const std::vector<QString>& labels);
+
+		void setValue(int row, const QString& text, const QColor& color);
+		bool updateVertices();
+		void paint(QPainter* painter) const;
+
+		const QImage& getAtlasImage() const;
+		const std::vector<InfoPanelVertex>& getVertices() const;
+
+	private:
+
+		void addQuad(const QRect& rect, const QRect& atlasRect, const QColor& color);
+
+		QImage atlasImage;
+		QRect panelRect;
+		InfoPanelGlyph glyphs[128];
+
+		std::vector<InfoPanelRow> rows;
+		std::vector<InfoPanelVertex> vertices;
+		bool verticesChanged = true;
+
+		int textY = 0;
+		int valueX = 0;
+		int lineHeight = 0;
+		int lineSpacing = 0;
+	};
+}
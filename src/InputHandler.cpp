@@ -199,17 +199,17 @@ void InputHandler::handleInput(double frameTime)
 		if (keyIsDownWithRepeat(Qt::Key_Left, seekBackwardRepeatHandler))
 		{
 			videoDecoder->seekRelative(-seekAmount);
+			videoDecoderThread->resetAfterSeek();
 			videoDecoderThread->signalFrameRead();
 			renderOnScreenThread->advanceOneFrame();
-			videoStabilizer->reset();
 		}
 
 		if (keyIsDownWithRepeat(Qt::Key_Right, seekForwardRepeatHandler))
 		{
 			videoDecoder->seekRelative(seekAmount);
+			videoDecoderThread->resetAfterSeek();
 			videoDecoderThread->signalFrameRead();
 			renderOnScreenThread->advanceOneFrame();
-			videoStabilizer->reset();
 		}
 	}
 
@@ -20,6 +20,8 @@
 #include "QuickRouteReader.h"
 #include "MapImageReader.h"
 #include "VideoStabilizer.h"
+#include "TelemetryReader.h"
+#include "StabilizerCache.h"
 #include "InputHandler.h"
 #include "SplitsManager.h"
 #include "RouteManager.h"
@@ -32,6 +34,24 @@
 
 using namespace OrientView;
 
+namespace
+{
+	// the stabilizer itself doesn't fingerprint videos, so the verified cache file is looked up here and only used when no pass two file is selected
+	QString findStabilizerCacheFilePath(Settings* settings)
+	{
+		if (settings->stabilizer.mode != VideoStabilizerMode::Preprocessed || !settings->stabilizer.useCache || !settings->stabilizer.inputDataFilePath.isEmpty())
+			return QString();
+
+		StabilizerCache stabilizerCache;
+		std::vector<FramePosition> cumulativeFramePositions;
+
+		if (!stabilizerCache.initialize(settings) || !stabilizerCache.readCumulativeFramePositions(cumulativeFramePositions))
+			return QString();
+
+		return stabilizerCache.getCacheFilePath();
+	}
+}
+
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow)
 {
 	ui->setupUi(this);
@@ -213,7 +233,7 @@ void MainWindow::on_actionPlayVideo_triggered()
 		if (!renderer->initialize(videoDecoder, mapImageReader, videoStabilizer, inputHandler, routeManager, settings, false))
 			throw std::runtime_error("Could not initialize renderer");
 
-		if (!videoStabilizer->initialize(settings, false))
+		if (!videoStabilizer->initialize(settings, false, findStabilizerCacheFilePath(settings)))
 			throw std::runtime_error("Could not initialize video stabilizer");
 
 		inputHandler->initialize(videoWindow, renderer, videoDecoder, videoDecoderThread, videoStabilizer, routeManager, renderOnScreenThread, settings);
@@ -222,7 +242,7 @@ void MainWindow::on_actionPlayVideo_triggered()
 		if (!routeManager->initialize(quickRouteReader, splitsManager, renderer, settings))
 			throw std::runtime_error("Could not initialize route manager");
 
-		videoDecoderThread->initialize(videoDecoder);
+		videoDecoderThread->initialize(videoDecoder, videoStabilizer, settings);
 		renderOnScreenThread->initialize(this, videoWindow, videoDecoder, videoDecoderThread, videoStabilizer, routeManager, renderer, inputHandler);
 
 		connect(videoWindow, &VideoWindow::closing, this, &MainWindow::playVideoFinished);
@@ -392,7 +412,7 @@ void MainWindow::on_actionEncodeVideo_triggered()
 		if (!renderer->initialize(videoDecoder, mapImageReader, videoStabilizer, inputHandler, routeManager, settings, true))
 			throw std::runtime_error("Could not initialize renderer");
 
-		if (!videoStabilizer->initialize(settings, false))
+		if (!videoStabilizer->initialize(settings, false, findStabilizerCacheFilePath(settings)))
 			throw std::runtime_error("Could not initialize video stabilizer");
 
 		splitsManager->initialize(settings);
@@ -400,7 +420,7 @@ void MainWindow::on_actionEncodeVideo_triggered()
 		if (!routeManager->initialize(quickRouteReader, splitsManager, renderer, settings))
 			throw std::runtime_error("Could not initialize route manager");
 
-		videoDecoderThread->initialize(videoDecoder);
+		videoDecoderThread->initialize(videoDecoder, videoStabilizer, settings);
 		renderOffScreenThread->initialize(this, encodeWindow, videoDecoder, videoDecoderThread, videoStabilizer, routeManager, renderer, videoEncoder);
 		videoEncoderThread->initialize(videoDecoder, videoEncoder, renderOffScreenThread);
 
@@ -411,8 +431,11 @@ void MainWindow::on_actionEncodeVideo_triggered()
 		encodeWindow->setModal(true);
 		encodeWindow->show();
 
-		encodeWindow->getContext()->doneCurrent();
-		encodeWindow->getContext()->moveToThread(renderOffScreenThread);
+		if (encodeWindow->getContext() != nullptr)
+		{
+			encodeWindow->getContext()->doneCurrent();
+			encodeWindow->getContext()->moveToThread(renderOffScreenThread);
+		}
 
 		videoDecoderThread->start();
 		renderOffScreenThread->start();
@@ -457,7 +480,7 @@ void MainWindow::encodeVideoFinished()
 		videoDecoderThread = nullptr;
 	}
 
-	if (encodeWindow != nullptr && encodeWindow->getIsInitialized())
+	if (encodeWindow != nullptr && encodeWindow->getIsInitialized() && encodeWindow->getContext() != nullptr)
 		encodeWindow->getContext()->makeCurrent(encodeWindow->getSurface());
 
 	if (routeManager != nullptr)
@@ -711,6 +734,51 @@ void MainWindow::on_pushButtonVideoStabilizerPassOneRun_clicked()
 
 	settings->readFromUI(ui);
 
+	StabilizerCache stabilizerCache;
+
+	// the same video was already analyzed with the same settings
+	if (settings->stabilizer.useCache && stabilizerCache.initialize(settings) && stabilizerCache.copyCumulativeFramePositions(settings->stabilizer.passOneOutputFilePath))
+	{
+		QMessageBox::information(this, "OrientView - Information", "First preprocess pass was found in the cache.", QMessageBox::Ok);
+		this->setCursor(Qt::ArrowCursor);
+		return;
+	}
+
+	// the gyro track gives the same output as the optical flow analysis without decoding the video
+	if (settings->stabilizer.useTelemetry)
+	{
+		QFile fileOut(settings->stabilizer.passOneOutputFilePath);
+		TelemetryReader telemetryReader;
+
+		try
+		{
+			if (!telemetryReader.initialize(settings))
+				throw std::runtime_error("Could not read telemetry");
+
+			if (!fileOut.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+				throw std::runtime_error("Could not open output file");
+
+			telemetryReader.writeCumulativeFramePositions(fileOut);
+			fileOut.close();
+
+			if (settings->stabilizer.useCache)
+				stabilizerCache.storeCumulativeFramePositions(settings->stabilizer.passOneOutputFilePath);
+
+			QMessageBox::information(this, "OrientView - Information", "First preprocess pass completed successfully.", QMessageBox::Ok);
+		}
+		catch (const std::exception& ex)
+		{
+			qWarning("%s", ex.what());
+			QMessageBox::critical(this, "OrientView - Error", QString("%1.\n\nCheck the application log for details.").arg(ex.what()), QMessageBox::Ok);
+		}
+
+		if (fileOut.isOpen())
+			fileOut.close();
+
+		this->setCursor(Qt::ArrowCursor);
+		return;
+	}
+
 	try
 	{
 		stabilizeWindow = new StabilizeWindow(this);
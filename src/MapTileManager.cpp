@@ -0,0 +1,415 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#include <algorithm>
+#include <cmath>
+
+#include <QMutexLocker>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLTexture>
+#include <QRunnable>
+#include <QThread>
+
+#include "MapTileManager.h"
+#include "Settings.h"
+
+using namespace OrientView;
+
+namespace
+{
+	// enough for the bicubic shader to sample two texels across tile edges on the first two mip levels
+	const int tileBorder = 4;
+
+	// a level is picked so that its tiles are at most about two times minified, the mips below that would run out of border
+	const int maxTileMipLevel = 1;
+
+	// uploads and mipmap generation are spread over frames so that zooming doesn't cause hitches
+	const int maxUploadsPerFrame = 8;
+	const int maxPendingTileCount = 64;
+
+	uint64_t getTileKey(int level, int x, int y)
+	{
+		return ((uint64_t)level << 48) | ((uint64_t)y << 24) | (uint64_t)x;
+	}
+
+	class LevelBuilder : public QRunnable
+	{
+
+	public:
+
+		LevelBuilder(MapTileManager* mapTileManager) : mapTileManager(mapTileManager) {}
+		void run() { mapTileManager->buildLevelImages(); }
+
+	private:
+
+		MapTileManager* mapTileManager;
+	};
+
+	class TileLoader : public QRunnable
+	{
+
+	public:
+
+		TileLoader(MapTileManager* mapTileManager, int level, int x, int y) : mapTileManager(mapTileManager), level(level), x(x), y(y) {}
+		void run() { mapTileManager->loadTileImage(level, x, y); }
+
+	private:
+
+		MapTileManager* mapTileManager;
+		int level;
+		int x;
+		int y;
+	};
+}
+
+bool MapTileManager::initialize(const QImage& mapImage, Settings* settings)
+{
+	qDebug("Initializing map tile manager");
+
+	if (mapImage.isNull())
+	{
+		qWarning("Could not create map tiles from an empty image");
+		return false;
+	}
+
+	GLint maxTextureSize = 0;
+	QOpenGLContext::currentContext()->functions()->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+	tileSize = std::max(64, std::min(settings->map.tileSize, (int)maxTextureSize - 2 * tileBorder));
+	maxResidentByteCount = (int64_t)settings->map.tileCacheSize * 1024 * 1024;
+
+	// rotated maps and oblique footprints blur with plain trilinear filtering
+	if (QOpenGLContext::currentContext()->hasExtension("GL_EXT_texture_filter_anisotropic"))
+		maxAnisotropy = std::max(1.0f, (float)settings->map.maxAnisotropy);
+	else
+		maxAnisotropy = 1.0f;
+	mapWidth = mapImage.width();
+	mapHeight = mapImage.height();
+
+	// each level halves the previous one until the whole map fits in a single tile
+	levelSizes.clear();
+	levelSizes.push_back(mapImage.size());
+
+	while (levelSizes.back().width() > tileSize || levelSizes.back().height() > tileSize)
+		levelSizes.push_back(QSize(std::max(1, levelSizes.back().width() / 2), std::max(1, levelSizes.back().height() / 2)));
+
+	int topLevel = (int)levelSizes.size() - 1;
+
+	levelImages.clear();
+	levelImages.resize(levelSizes.size());
+	levelImages[0] = (mapImage.depth() == 32) ? mapImage : mapImage.convertToFormat(QImage::Format_ARGB32);
+
+	if (topLevel > 0)
+		levelImages[topLevel] = levelImages[0].scaled(levelSizes[topLevel], Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+	qDebug("Map is split into %d levels of %dx%d tiles", (int)levelSizes.size(), tileSize, tileSize);
+
+	// the single top level tile is always resident so that there's something to draw while the finer tiles load
+	loadTileImage(topLevel, 0, 0);
+	uploadLoadedTiles(1);
+
+	if (residentTiles.empty())
+	{
+		qWarning("Could not create top level map tile");
+		return false;
+	}
+
+	threadPool.setMaxThreadCount(std::max(1, std::min(QThread::idealThreadCount() - 1, 4)));
+
+	if (topLevel > 1)
+		threadPool.start(new LevelBuilder(this));
+
+	return true;
+}
+
+MapTileManager::~MapTileManager()
+{
+	isShuttingDown = true;
+
+	threadPool.clear();
+	threadPool.waitForDone();
+
+	deleteTiles();
+}
+
+void MapTileManager::buildLevelImages()
+{
+	QImage previousImage;
+
+	{
+		QMutexLocker locker(&mutex);
+		previousImage = levelImages[0];
+	}
+
+	for (int level = 1; level < (int)levelSizes.size() - 1 && !isShuttingDown; ++level)
+	{
+		QImage levelImage = previousImage.scaled(levelSizes[level], Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+		QMutexLocker locker(&mutex);
+		levelImages[level] = levelImage;
+		previousImage = levelImage;
+	}
+}
+
+void MapTileManager::loadTileImage(int level, int x, int y)
+{
+	QImage levelImage;
+
+	{
+		QMutexLocker locker(&mutex);
+		levelImage = levelImages[level];
+	}
+
+	if (levelImage.isNull() || isShuttingDown)
+		return;
+
+	int levelWidth = levelImage.width();
+	int levelHeight = levelImage.height();
+	int startX = x * tileSize;
+	int startY = y * tileSize;
+	int width = std::min(tileSize, levelWidth - startX);
+	int height = std::min(tileSize, levelHeight - startY);
+
+	if (width <= 0 || height <= 0)
+		return;
+
+	LoadedMapTile loadedTile;
+	loadedTile.level = level;
+	loadedTile.x = x;
+	loadedTile.y = y;
+	loadedTile.image = QImage(width + 2 * tileBorder, height + 2 * tileBorder, levelImage.format());
+
+	// the border repeats the neighbouring tiles, or the edge pixels at the map edges
+	for (int ty = 0; ty < loadedTile.image.height(); ++ty)
+	{
+		int sourceY = std::max(0, std::min(startY - tileBorder + ty, levelHeight - 1));
+		const QRgb* source = (const QRgb*)levelImage.constScanLine(sourceY);
+		QRgb* destination = (QRgb*)loadedTile.image.scanLine(ty);
+
+		for (int tx = 0; tx < loadedTile.image.width(); ++tx)
+			destination[tx] = source[std::max(0, std::min(startX - tileBorder + tx, levelWidth - 1))];
+	}
+
+	QMutexLocker locker(&mutex);
+	loadedTiles.push_back(loadedTile);
+}
+
+std::vector<MapTile*> MapTileManager::getVisibleTiles(const QRectF& visibleRect, double scale)
+{
+	++frameIndex;
+	missingTiles = false;
+
+	uploadLoadedTiles(maxUploadsPerFrame);
+
+	int levelCount = (int)levelSizes.size();
+	int level = 0;
+
+	// pick the level that is magnified a little, the tile mipmaps take care of the rest of the minification
+	if (scale > 0.0)
+		level = std::max(0, std::min((int)floor(log2(1.0 / scale)), levelCount - 1));
+
+	QRectF mapRect = visibleRect.intersected(QRectF(0.0, 0.0, mapWidth, mapHeight));
+
+	std::vector<MapTile*> fallbackTiles;
+	std::vector<MapTile*> visibleTiles;
+
+	if (mapRect.isEmpty())
+		return visibleTiles;
+
+	double tileMapWidth = tileSize * (mapWidth / levelSizes[level].width());
+	double tileMapHeight = tileSize * (mapHeight / levelSizes[level].height());
+	int tileCountX = (levelSizes[level].width() + tileSize - 1) / tileSize;
+	int tileCountY = (levelSizes[level].height() + tileSize - 1) / tileSize;
+
+	int startX = std::max(0, (int)floor(mapRect.left() / tileMapWidth));
+	int startY = std::max(0, (int)floor(mapRect.top() / tileMapHeight));
+	int endX = std::min(tileCountX - 1, (int)floor(mapRect.right() / tileMapWidth));
+	int endY = std::min(tileCountY - 1, (int)floor(mapRect.bottom() / tileMapHeight));
+
+	for (int y = startY; y <= endY; ++y)
+	{
+		for (int x = startX; x <= endX; ++x)
+		{
+			auto it = residentTiles.find(getTileKey(level, x, y));
+
+			if (it != residentTiles.end())
+			{
+				it->second.lastUsedFrame = frameIndex;
+				visibleTiles.push_back(&it->second);
+				continue;
+			}
+
+			requestTile(level, x, y);
+			missingTiles = true;
+
+			// draw the closest coarser tile in the meantime, the top level is always there
+			for (int coarserLevel = level + 1; coarserLevel < levelCount; ++coarserLevel)
+			{
+				int shift = coarserLevel - level;
+				auto coarserIt = residentTiles.find(getTileKey(coarserLevel, x >> shift, y >> shift));
+
+				if (coarserIt != residentTiles.end())
+				{
+					if (coarserIt->second.lastUsedFrame != frameIndex)
+					{
+						coarserIt->second.lastUsedFrame = frameIndex;
+						fallbackTiles.push_back(&coarserIt->second);
+					}
+
+					break;
+				}
+			}
+		}
+	}
+
+	evictTiles();
+
+	// coarse tiles first, the finer ones are drawn on top of them
+	std::sort(fallbackTiles.begin(), fallbackTiles.end(), [](const MapTile* a, const MapTile* b) { return a->level > b->level; });
+	fallbackTiles.insert(fallbackTiles.end(), visibleTiles.begin(), visibleTiles.end());
+
+	return fallbackTiles;
+}
+
+void MapTileManager::requestTile(int level, int x, int y)
+{
+	uint64_t key = getTileKey(level, x, y);
+
+	if (pendingTiles.count(key) > 0 || (int)pendingTiles.size() >= maxPendingTileCount)
+		return;
+
+	{
+		QMutexLocker locker(&mutex);
+
+		// the intermediate levels are still being built, the coarser fallback is used until then
+		if (levelImages[level].isNull())
+			return;
+	}
+
+	pendingTiles.insert(key);
+	threadPool.start(new TileLoader(this, level, x, y));
+}
+
+void MapTileManager::uploadLoadedTiles(int maxTileCount)
+{
+	for (int i = 0; i < maxTileCount; ++i)
+	{
+		LoadedMapTile loadedTile;
+
+		{
+			QMutexLocker locker(&mutex);
+
+			if (loadedTiles.empty())
+				break;
+
+			loadedTile = loadedTiles.front();
+			loadedTiles.pop_front();
+		}
+
+		uint64_t key = getTileKey(loadedTile.level, loadedTile.x, loadedTile.y);
+		pendingTiles.erase(key);
+
+		if (residentTiles.count(key) > 0)
+			continue;
+
+		MapTile& tile = residentTiles[key];
+		tile.level = loadedTile.level;
+		tile.x = loadedTile.x;
+		tile.y = loadedTile.y;
+		tile.textureWidth = loadedTile.image.width();
+		tile.textureHeight = loadedTile.image.height();
+		tile.lastUsedFrame = frameIndex;
+
+		tile.texture = new QOpenGLTexture(loadedTile.image, QOpenGLTexture::GenerateMipMaps);
+		tile.texture->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
+		tile.texture->setMagnificationFilter(QOpenGLTexture::Linear);
+		tile.texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+
+		if (maxAnisotropy > 1.0f)
+			tile.texture->setMaximumAnisotropy(maxAnisotropy);
+
+		// the top level tile only has the map edges around it, so it keeps the whole chain for zooming out further
+		if (tile.level == (int)levelSizes.size() - 1)
+			tile.maxMipLevel = tile.texture->mipLevels() - 1;
+		else
+			tile.maxMipLevel = std::min(maxTileMipLevel, tile.texture->mipLevels() - 1);
+
+		tile.texture->setMipMaxLevel(tile.maxMipLevel);
+
+		int width = tile.textureWidth - 2 * tileBorder;
+		int height = tile.textureHeight - 2 * tileBorder;
+		double levelScaleX = mapWidth / levelSizes[tile.level].width();
+		double levelScaleY = mapHeight / levelSizes[tile.level].height();
+
+		tile.mapRect = QRectF(tile.x * tileSize * levelScaleX, tile.y * tileSize * levelScaleY, width * levelScaleX, height * levelScaleY);
+		tile.textureRect = QRectF((double)tileBorder / tile.textureWidth, (double)tileBorder / tile.textureHeight, (double)width / tile.textureWidth, (double)height / tile.textureHeight);
+
+		// the full mip chain adds a third on top of the base level
+		tile.byteCount = (int64_t)tile.textureWidth * tile.textureHeight * 4 * 4 / 3;
+		residentByteCount += tile.byteCount;
+	}
+}
+
+void MapTileManager::evictTiles()
+{
+	int topLevel = (int)levelSizes.size() - 1;
+
+	while (residentByteCount > maxResidentByteCount)
+	{
+		auto leastRecentlyUsedIt = residentTiles.end();
+
+		for (auto it = residentTiles.begin(); it != residentTiles.end(); ++it)
+		{
+			if (it->second.level == topLevel || it->second.lastUsedFrame == frameIndex)
+				continue;
+
+			if (leastRecentlyUsedIt == residentTiles.end() || it->second.lastUsedFrame < leastRecentlyUsedIt->second.lastUsedFrame)
+				leastRecentlyUsedIt = it;
+		}
+
+		// everything left is needed for the current frame, go over the budget rather than flicker
+		if (leastRecentlyUsedIt == residentTiles.end())
+			break;
+
+		residentByteCount -= leastRecentlyUsedIt->second.byteCount;
+		delete leastRecentlyUsedIt->second.texture;
+		residentTiles.erase(leastRecentlyUsedIt);
+	}
+}
+
+void MapTileManager::deleteTiles()
+{
+	for (auto& it : residentTiles)
+	{
+		if (it.second.texture != nullptr)
+		{
+			delete it.second.texture;
+			it.second.texture = nullptr;
+		}
+	}
+
+	residentTiles.clear();
+	pendingTiles.clear();
+	residentByteCount = 0;
+}
+
+int MapTileManager::getLevelCount() const
+{
+	return (int)levelSizes.size();
+}
+
+bool MapTileManager::hasMissingTiles() const
+{
+	return missingTiles;
+}
+
+int MapTileManager::getResidentTileCount() const
+{
+	return (int)residentTiles.size();
+}
+
+int64_t MapTileManager::getResidentByteCount() const
+{
+	return residentByteCount;
+}
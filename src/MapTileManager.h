@@ -0,0 +1,98 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <QImage>
+#include <QMutex>
+#include <QRectF>
+#include <QSize>
+#include <QThreadPool>
+
+class QOpenGLTexture;
+
+namespace OrientView
+{
+	class Settings;
+
+	// One piece of the map pyramid that is resident on the GPU.
+	struct MapTile
+	{
+		int level = 0;
+		int x = 0;
+		int y = 0;
+
+		QOpenGLTexture* texture = nullptr;
+		int textureWidth = 0;
+		int textureHeight = 0;
+		int maxMipLevel = 0;
+
+		QRectF mapRect; // full resolution map pixels
+		QRectF textureRect; // the part inside the border, texture coordinates
+
+		int64_t byteCount = 0;
+		int lastUsedFrame = 0;
+	};
+
+	struct LoadedMapTile
+	{
+		int level = 0;
+		int x = 0;
+		int y = 0;
+
+		QImage image;
+	};
+
+	// Split the map image into a mipmapped tile pyramid and keep the visible tiles resident under a memory budget.
+	class MapTileManager
+	{
+
+	public:
+
+		bool initialize(const QImage& mapImage, Settings* settings);
+		~MapTileManager();
+
+		std::vector<MapTile*> getVisibleTiles(const QRectF& visibleRect, double scale);
+
+		void buildLevelImages();
+		void loadTileImage(int level, int x, int y);
+
+		int getLevelCount() const;
+		bool hasMissingTiles() const;
+		int getResidentTileCount() const;
+		int64_t getResidentByteCount() const;
+
+	private:
+
+		void requestTile(int level, int x, int y);
+		void uploadLoadedTiles(int maxTileCount);
+		void evictTiles();
+		void deleteTiles();
+
+		int tileSize = 512;
+		int64_t maxResidentByteCount = 0;
+		float maxAnisotropy = 1.0f;
+		double mapWidth = 0.0;
+		double mapHeight = 0.0;
+
+		std::vector<QSize> levelSizes;
+		std::vector<QImage> levelImages;
+		std::deque<LoadedMapTile> loadedTiles;
+		QMutex mutex;
+		std::atomic<bool> isShuttingDown { false };
+
+		QThreadPool threadPool;
+		std::set<uint64_t> pendingTiles;
+		std::map<uint64_t, MapTile> residentTiles;
+		int64_t residentByteCount = 0;
+		int frameIndex = 0;
+		bool missingTiles = false;
+	};
+}
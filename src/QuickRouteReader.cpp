@@ -13,12 +13,53 @@ using namespace OrientView;
 
 bool QuickRouteReader::initialize(MapImageReader* mapImageReader, Settings* settings)
 {
-	qDebug("Initializing QuickRoute reader (%s)", qPrintable(settings->route.quickRouteJpegFilePath));
-
 	mapImageWidth = mapImageReader->getMapImage().width();
 	mapImageHeight = mapImageReader->getMapImage().height();
 
-	QFile file(settings->route.quickRouteJpegFilePath);
+	ghostRoutePoints.clear();
+
+	// the ghost routes go through the same members, so they are read first and the main route is left in them
+	for (int i = 0; i < settings->route.ghostRouteFilePaths.size(); ++i)
+	{
+		const QString& ghostRouteFilePath = settings->route.ghostRouteFilePaths.at(i);
+
+		qDebug("Reading ghost route (%s)", qPrintable(ghostRouteFilePath));
+
+		if (!readFile(ghostRouteFilePath))
+		{
+			qWarning("Could not read ghost route %s, skipping it", qPrintable(ghostRouteFilePath));
+			continue;
+		}
+
+		GhostRoutePoints ghostRoute;
+		ghostRoute.settingsIndex = i;
+		ghostRoute.routePoints = routePoints;
+
+		ghostRoutePoints.push_back(ghostRoute);
+	}
+
+	qDebug("Initializing QuickRoute reader (%s)", qPrintable(settings->route.quickRouteJpegFilePath));
+
+	return readFile(settings->route.quickRouteJpegFilePath);
+}
+
+const std::vector<RoutePoint>& QuickRouteReader::getRoutePoints() const
+{
+	return routePoints;
+}
+
+const std::vector<GhostRoutePoints>& QuickRouteReader::getGhostRoutePoints() const
+{
+	return ghostRoutePoints;
+}
+
+bool QuickRouteReader::readFile(const QString& fileName)
+{
+	routePoints.clear();
+	routePointHandles.clear();
+	projectionOriginCoordinate = QPointF();
+
+	QFile file(fileName);
 
 	if (!file.open(QIODevice::ReadOnly))
 	{
@@ -47,11 +88,6 @@ bool QuickRouteReader::initialize(MapImageReader* mapImageReader, Settings* sett
 	return true;
 }
 
-const std::vector<RoutePoint>& QuickRouteReader::getRoutePoints() const
-{
-	return routePoints;
-}
-
 bool QuickRouteReader::extractDataPartFromJpeg(QFile& file, QByteArray& buffer)
 {
 	const int quickRouteIdLength = 10;
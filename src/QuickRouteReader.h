@@ -15,6 +15,12 @@ namespace OrientView
 	class MapImageReader;
 	class Settings;
 
+	struct GhostRoutePoints
+	{
+		int settingsIndex = 0; // position in the configured ghost route list, for the time offset and color
+		std::vector<RoutePoint> routePoints;
+	};
+
 	// Read route point data from QuickRoute JPEG files.
 	class QuickRouteReader
 	{
@@ -24,9 +30,11 @@ namespace OrientView
 		bool initialize(MapImageReader* mapImageReader, Settings* settings);
 
 		const std::vector<RoutePoint>& getRoutePoints() const;
+		const std::vector<GhostRoutePoints>& getGhostRoutePoints() const;
 
 	private:
 
+		bool readFile(const QString& fileName);
 		bool extractDataPartFromJpeg(QFile& file, QByteArray& buffer);
 		bool readBytes(QFile& file, QByteArray& buffer, int count);
 		void processDataPart(QDataStream& dataStream);
@@ -52,5 +60,6 @@ namespace OrientView
 		QPointF projectionOriginCoordinate;
 		std::vector<RoutePoint> routePoints;
 		std::vector<RoutePointHandle> routePointHandles;
+		std::vector<GhostRoutePoints> ghostRoutePoints;
 	};
 }
@@ -51,6 +51,9 @@ void RenderOffScreenThread::run()
 	FrameData decodedFrameData;
 	FrameData decodedFrameDataGrayscale;
 
+	// null when the renderer composites in software
+	QOpenGLContext* context = encodeWindow->getContext();
+
 	double frameDuration = videoDecoder->getFrameDuration();
 
 	frameReadSemaphore->release(1);
@@ -60,29 +63,97 @@ void RenderOffScreenThread::run()
 		if (videoDecoderThread->tryGetNextFrame(decodedFrameData, decodedFrameDataGrayscale, 100))
 		{
 			videoStabilizer->processFrame(decodedFrameDataGrayscale);
-			encodeWindow->getContext()->makeCurrent(encodeWindow->getSurface());
-			renderer->startRendering(videoDecoder->getCurrentTime(), frameDuration, videoDecoder->getDecodeDuration(), videoStabilizer->getProcessDuration(), videoEncoder->getEncodeDuration(), 0.0);
+
+			if (context != nullptr)
+				context->makeCurrent(encodeWindow->getSurface());
+
+			renderer->startRendering(videoDecoderThread->getCurrentTime(), frameDuration, videoDecoder->getDecodeDuration(), videoStabilizer->getProcessDuration(), videoEncoder->getEncodeDuration(), 0.0);
 			renderer->uploadFrameData(decodedFrameData);
 			videoDecoderThread->signalFrameRead();
 			renderer->renderAll();
 			renderer->stopRendering();
-			routeManager->update(videoDecoder->getCurrentTime(), frameDuration);
+			routeManager->update(videoDecoderThread->getCurrentTime(), frameDuration);
+
+			// keep one slot for the frame the encoder is reading and the rest for frames rendered ahead of it
+			// only a full ring makes the renderer wait for the encoder
+			if (renderer->getPendingReadbackCount() > 0 && renderer->getPendingReadbackCount() >= renderer->getReadbackBufferCount() - 1)
+			{
+				if (!passRenderedFrame())
+					break;
+			}
+
+			// an idle encoder gets the oldest frame right away, the newest one stays in flight so its readback overlaps with the next render
+			while (renderer->getPendingReadbackCount() > 1 && frameReadSemaphore->available() > 0)
+			{
+				if (!passRenderedFrame())
+					break;
+			}
+
+			FrameData frameInfo;
+			frameInfo.duration = decodedFrameData.duration;
+			frameInfo.cumulativeNumber = decodedFrameData.cumulativeNumber;
+			pendingFrameInfos.push_back(frameInfo);
+
+			renderer->readRenderedFrame();
+		}
+		else if (videoDecoderThread->getIsFinished())
+		{
+			// flush the frames still in the readback ring
+			while (renderer->getPendingReadbackCount() > 0)
+			{
+				if (!passRenderedFrame())
+					break;
+			}
+
+			if (!isInterruptionRequested() && waitForFrameRead())
+			{
+				renderer->releaseRenderedFrame();
+				isFinished = true;
+			}
+
+			break;
+		}
+	}
 
-			while (!frameReadSemaphore->tryAcquire(1, 100) && !isInterruptionRequested()) {}
+	renderer->releaseRenderedFrame();
 
-			if (isInterruptionRequested())
-				break;
+	if (context != nullptr)
+	{
+		context->doneCurrent();
+		context->moveToThread(mainWindow->thread());
+	}
+}
 
-			renderedFrameData = renderer->getRenderedFrame();
-			renderedFrameData.duration = decodedFrameData.duration;
-			renderedFrameData.cumulativeNumber = decodedFrameData.cumulativeNumber;
+bool RenderOffScreenThread::waitForFrameRead()
+{
+	while (!frameReadSemaphore->tryAcquire(1, 100) && !isInterruptionRequested()) {}
 
-			frameAvailableSemaphore->release(1);
-		}
+	return !isInterruptionRequested();
+}
+
+bool RenderOffScreenThread::passRenderedFrame()
+{
+	if (!waitForFrameRead())
+		return false;
+
+	// the encoder is done with the previous frame, so its buffer can be reused
+	renderer->releaseRenderedFrame();
+
+	FrameData frameInfo = pendingFrameInfos.front();
+	pendingFrameInfos.pop_front();
+
+	if (!renderer->getRenderedFrame(renderedFrameData))
+	{
+		frameReadSemaphore->release(1);
+		return true;
 	}
 
-	encodeWindow->getContext()->doneCurrent();
-	encodeWindow->getContext()->moveToThread(mainWindow->thread());
+	renderedFrameData.duration = frameInfo.duration;
+	renderedFrameData.cumulativeNumber = frameInfo.cumulativeNumber;
+
+	frameAvailableSemaphore->release(1);
+
+	return true;
 }
 
 bool RenderOffScreenThread::tryGetNextFrame(FrameData& frameData, int timeout)
@@ -100,3 +171,8 @@ void RenderOffScreenThread::signalFrameRead()
 {
 	frameReadSemaphore->release(1);
 }
+
+bool RenderOffScreenThread::getIsFinished() const
+{
+	return isFinished;
+}
@@ -3,6 +3,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
+
 #include <QThread>
 #include <QSemaphore>
 
@@ -31,6 +34,7 @@ namespace OrientView
 
 		bool tryGetNextFrame(FrameData& frameData, int timeout);
 		void signalFrameRead();
+		bool getIsFinished() const;
 
 	protected:
 
@@ -38,6 +42,9 @@ namespace OrientView
 
 	private:
 
+		bool passRenderedFrame();
+		bool waitForFrameRead();
+
 		MainWindow* mainWindow = nullptr;
 		EncodeWindow* encodeWindow = nullptr;
 		VideoDecoder* videoDecoder = nullptr;
@@ -51,5 +58,8 @@ namespace OrientView
 		QSemaphore* frameAvailableSemaphore = nullptr;
 
 		FrameData renderedFrameData;
+		std::deque<FrameData> pendingFrameInfos;
+
+		std::atomic<bool> isFinished { false };
 	};
 }
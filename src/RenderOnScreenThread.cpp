@@ -2,6 +2,7 @@
 // License: GPLv3, see the LICENSE file.
 
 #include <QElapsedTimer>
+#include <QScreen>
 
 #include "RenderOnScreenThread.h"
 #include "MainWindow.h"
@@ -12,6 +13,7 @@
 #include "RouteManager.h"
 #include "Renderer.h"
 #include "InputHandler.h"
+#include "FramePacer.h"
 #include "Settings.h"
 
 using namespace OrientView;
@@ -37,12 +39,16 @@ void RenderOnScreenThread::run()
 	double frameDuration = 30.0;
 	double spareTime = 15.0;
 
+	FramePacer framePacer;
+	framePacer.initialize(videoWindow->screen()->refreshRate(), videoWindow->getContext()->format().swapInterval());
+
 	frameDurationTimer.start();
 
 	while (!isInterruptionRequested())
 	{
 		if (!videoWindow->isExposed())
 		{
+			framePacer.reset();
 			QThread::msleep(100);
 			continue;
 		}
@@ -56,10 +62,15 @@ void RenderOnScreenThread::run()
 		}
 
 		if (gotFrame)
+		{
 			videoStabilizer->processFrame(frameDataGrayscale);
+			framePacer.scheduleFrame(frameData.duration);
+		}
+		else if (isPaused)
+			framePacer.reset();
 
 		videoWindow->getContext()->makeCurrent(videoWindow);
-		renderer->startRendering(videoDecoder->getCurrentTime(), frameDuration, videoDecoder->getDecodeDuration(), videoStabilizer->getProcessDuration(), 0.0, spareTime);
+		renderer->startRendering(videoDecoderThread->getCurrentTime(), frameDuration, videoDecoder->getDecodeDuration(), videoStabilizer->getProcessDuration(), 0.0, spareTime);
 
 		videoDecoder->resetDecodeDuration();
 		videoStabilizer->resetProcessDuration();
@@ -73,7 +84,7 @@ void RenderOnScreenThread::run()
 		renderer->renderAll();
 		renderer->stopRendering();
 
-		routeManager->update(videoDecoder->getCurrentTime(), frameDuration);
+		routeManager->update(videoDecoderThread->getCurrentTime(), frameDuration);
 		inputHandler->handleInput(frameDuration);
 
 		if (windowHasBeenResized)
@@ -83,35 +94,23 @@ void RenderOnScreenThread::run()
 			windowHasBeenResized = false;
 		}
 
-		videoWindow->getContext()->swapBuffers(videoWindow);
-
+		// new frames are held back until their deadline, everything else is shown right away
 		if (gotFrame)
-		{
-			spareTime = (frameData.duration - (frameDurationTimer.nsecsElapsed() / 1000.0)) / 1000.0;
-
-			// use combination of normal and spinning wait to sync the frame rate accurately
-			while (true)
-			{
-				int64_t timeToSleep = frameData.duration - (frameDurationTimer.nsecsElapsed() / 1000);
-
-				if (timeToSleep > 2000)
-				{
-					QThread::msleep(1);
-					continue;
-				}
-				else if (timeToSleep > 0)
-					continue;
-				else
-					break;
-			}
-		}
+			spareTime = framePacer.waitForPresentation();
 		else
 			spareTime = 0.0;
 
+		videoWindow->getContext()->swapBuffers(videoWindow);
+
+		if (!gotFrame)
+			framePacer.waitForIdleFrame();
+
 		frameDuration = frameDurationTimer.nsecsElapsed() / 1000000.0;
 		frameDurationTimer.restart();
 	}
 
+	qDebug("Presented %lld frames, %lld late and %lld dropped", (long long)framePacer.getPresentedFrameCount(), (long long)framePacer.getLateFrameCount(), (long long)framePacer.getDroppedFrameCount());
+
 	videoWindow->getContext()->doneCurrent();
 	videoWindow->getContext()->moveToThread(mainWindow->thread());
 }
@@ -1,7 +1,15 @@
 // Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
 // License: GPLv3, see the LICENSE file.
 
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
 #include <QOpenGLPixelTransferOptions>
+#include <QOpenGLFunctions_3_2_Core>
 
 #include "Renderer.h"
 #include "VideoDecoder.h"
@@ -14,7 +22,101 @@
 
 using namespace OrientView;
 
-Panel::Panel() : texture(QOpenGLTexture::Target2D)
+namespace
+{
+	// GL_ARB_buffer_storage isn't part of the 3.2 core profile, so it's resolved at run time
+	typedef void (QOPENGLF_APIENTRYP BufferStorageFunction)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+	const GLbitfield mapPersistentBit = 0x0040;
+	const GLbitfield mapCoherentBit = 0x0080;
+
+	// the rescale filters span -X_RANGE - X_RANGE source texels, same as in the shaders
+	const double filterRange = 2.0;
+	const int weightCount = 256;
+
+	// shrinking more than this falls back to a wider, aliasing footprint instead of more taps
+	const double maxFilterScale = 4.0;
+
+	double sinc(double x)
+	{
+		return sin(M_PI * x) / (M_PI * x);
+	}
+
+	// the interpolation functions that used to be evaluated per tap in rescale_bicubic.frag, x is -2.0 - 2.0
+	double interpolationWeight(const QString& filterName, double lanczosSize, double x)
+	{
+		if (filterName == "triangle")
+		{
+			x = x / filterRange;
+			return (x <= 0.0) ? (x + 1.0) : (1.0 - x);
+		}
+
+		if (filterName == "bell")
+		{
+			x = (x / filterRange) * 1.5;
+
+			if (x >= -1.5 && x <= -0.5)
+				return 0.5 * pow(x + 1.5, 2.0);
+			else if (x > -0.5 && x <= 0.5)
+				return 3.0 / 4.0 - (x * x);
+			else if (x > 0.5 && x <= 1.5)
+				return 0.5 * pow(x - 1.5, 2.0);
+			else
+				return 0.0;
+		}
+
+		if (filterName == "bspline")
+		{
+			x = (fabs(x) / filterRange) * 2.0;
+
+			if (x >= 0.0 && x <= 1.0)
+				return (2.0 / 3.0) + 0.5 * (x * x * x) - (x * x);
+			else if (x > 1.0 && x <= 2.0)
+				return (1.0 / 6.0) * pow(2.0 - x, 3.0);
+			else
+				return 0.0;
+		}
+
+		if (filterName == "catmullrom")
+		{
+			const double B = 0.0;
+			const double C = 0.5;
+
+			x = (fabs(x) / filterRange) * 2.0;
+
+			if (x < 1.0)
+				return ((12 - 9 * B - 6 * C) * (x * x * x) + (-18 + 12 * B + 6 * C) * (x * x) + (6 - 2 * B)) / 6.0;
+			else if (x >= 1.0 && x <= 2.0)
+				return ((-B - 6 * C) * (x * x * x) + (6 * B + 30 * C) * (x * x) + (-12 * B - 48 * C) * x + 8 * B + 24 * C) / 6.0;
+			else
+				return 0.0;
+		}
+
+		// lanczos
+		x = (fabs(x) / filterRange) * lanczosSize;
+
+		if (x == 0.0)
+			return 1.0;
+		else
+			return sinc(x) * sinc(x / lanczosSize);
+	}
+
+	// taps on both sides of the sample point to cover the (possibly stretched) filter
+	int getTapCount(double filterScale)
+	{
+		return 2 * (int)ceil(filterRange * filterScale);
+	}
+}
+
+Panel::Panel() : texture(QOpenGLTexture::Target2D), weightTexture(QOpenGLTexture::Target2D)
+{
+}
+
+ReadbackBuffer::ReadbackBuffer() : pixelBuffer(QOpenGLBuffer::PixelPackBuffer)
+{
+}
+
+UploadBuffer::UploadBuffer() : pixelBuffer(QOpenGLBuffer::PixelUnpackBuffer)
 {
 }
 
@@ -51,6 +153,9 @@ bool Renderer::initialize(VideoDecoder* videoDecoder, MapImageReader* mapImageRe
 	mapPanel.relativeWidth = settings->map.relativeWidth;
 
 	multisamples = settings->window.multisamples;
+	antialiasingMode = settings->encoder.antialiasingMode;
+	renderAheadFrameCount = settings->encoder.renderAheadFrameCount;
+	renderAheadMemoryBudget = (int64_t)settings->encoder.renderAheadMemoryBudget * 1024 * 1024;
 	renderMode = settings->renderer.renderMode;
 	showInfoPanel = settings->renderer.showInfoPanel;
 	infoPanelFontSize = settings->renderer.infoPanelFontSize;
@@ -60,12 +165,76 @@ bool Renderer::initialize(VideoDecoder* videoDecoder, MapImageReader* mapImageRe
 	averageFrameDuration.setAlpha(averagingFactor);
 	averageDecodeDuration.setAlpha(averagingFactor);
 	averageStabilizeDuration.setAlpha(averagingFactor);
+	averageStabilizeAnalyzeDuration.setAlpha(averagingFactor);
 	averageRenderDuration.setAlpha(averagingFactor);
 	averageEncodeDuration.setAlpha(averagingFactor);
 	averageSpareTime.setAlpha(averagingFactor);
 
+	// the labels are fixed, only the values next to them are laid out again when they change
+	std::vector<QString> infoPanelLabels = { "time:", "", "fps:", "frame:", "decode:", "stabilize:", "stab. level:", "render:", renderToOffscreen ? "encode:" : "spare:", "",
+		"gpu video:", "gpu map:", "gpu route:", "gpu info panel:", "gpu resolve:", "gpu readback:", "",
+		"scroll:", "", "video scale:", "map scale:", "route scale:", "", "control offset:", "runner offset:" };
+
+	if (!infoPanel.initialize(infoPanelFontSize, infoPanelLabels))
+		return false;
+
+	// the encoder falls back to compositing on the CPU when it couldn't get an OpenGL context
+	renderInSoftware = renderToOffscreen && QOpenGLContext::currentContext() == nullptr;
+
+	if (renderInSoftware)
+	{
+		qDebug("No OpenGL context available, rendering in software");
+
+		if (!softwareCompositor.initialize(mapImageReader->getMapImage()))
+			return false;
+
+		return windowResized(settings->window.width, settings->window.height);
+	}
+
 	initializeOpenGLFunctions();
 
+	// fences and buffer mapping are needed for the asynchronous upload and readback, otherwise fall back to the synchronous calls
+	coreFunctions = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_2_Core>();
+
+	if (coreFunctions != nullptr && !coreFunctions->initializeOpenGLFunctions())
+		coreFunctions = nullptr;
+
+	if (coreFunctions == nullptr)
+		qWarning("OpenGL 3.2 is not available, using synchronous frame upload and readback");
+
+	// the CPU side render duration only covers submitting the commands, these tell where the GPU spends its time
+	gpuTimer.initialize(settings->renderer.gpuTimingLogFilePath);
+
+	if (!shaderCache.initialize(settings->renderer.cacheShaderBinaries))
+		return false;
+
+	if (renderToOffscreen)
+	{
+		// single channel render targets need OpenGL 3 as well
+		useYuvConversion = settings->encoder.useGpuColorConversion && coreFunctions != nullptr;
+
+		if (useYuvConversion && !loadYuvConversionShader())
+		{
+			qWarning("Could not load YUV conversion shader, converting on the CPU");
+			useYuvConversion = false;
+		}
+	}
+
+	// the map doesn't clear behind itself when clearing is off, so there would be nothing to cache
+	useMapCache = settings->renderer.cacheMapLayer && mapPanel.clearingEnabled;
+
+	// only the vector overlay is multisampled, the video and the map are drawn without it
+	// the same shader also draws the cached map layer
+	if ((useMapCache || (renderToOffscreen && antialiasingMode == "overlay")) && !loadOverlayShader())
+	{
+		qWarning("Could not load overlay shader, multisampling the whole frame and not caching the map");
+		antialiasingMode = "multisample";
+		useMapCache = false;
+	}
+
+	// without any multisampling the painter would draw aliased, so the tail, controls and runner go through the route shader instead
+	useOverlayShapes = renderToOffscreen && antialiasingMode == "analytic";
+
 	if (!windowResized(settings->window.width, settings->window.height))
 		return false;
 
@@ -105,7 +274,8 @@ bool Renderer::initialize(VideoDecoder* videoDecoder, MapImageReader* mapImageRe
 	videoPanel.vertexBuffer.allocate(videoPanelBuffer, sizeof(GLfloat) * 20);
 	videoPanel.vertexBuffer.release();
 
-	mapPanel.vertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+	// the map vertices are rewritten for every tile
+	mapPanel.vertexBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
 	mapPanel.vertexBuffer.create();
 	mapPanel.vertexBuffer.bind();
 	mapPanel.vertexBuffer.allocate(mapPanelBuffer, sizeof(GLfloat) * 20);
@@ -121,13 +291,11 @@ bool Renderer::initialize(VideoDecoder* videoDecoder, MapImageReader* mapImageRe
 	videoPanel.texture.allocateStorage();
 	videoPanel.texture.release();
 
-	mapPanel.texture.create();
-	mapPanel.texture.bind();
-	mapPanel.texture.setData(mapImageReader->getMapImage());
-	mapPanel.texture.setMinificationFilter(QOpenGLTexture::Linear);
-	mapPanel.texture.setMagnificationFilter(QOpenGLTexture::Linear);
-	mapPanel.texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-	mapPanel.texture.release();
+	if (coreFunctions != nullptr && !createUploadBuffers())
+		return false;
+
+	if (!mapTileManager.initialize(mapImageReader->getMapImage(), settings))
+		return false;
 
 	if (!loadRescaleShader(videoPanel, settings->video.rescaleShader))
 		return false;
@@ -135,6 +303,33 @@ bool Renderer::initialize(VideoDecoder* videoDecoder, MapImageReader* mapImageRe
 	if (!loadRescaleShader(mapPanel, settings->map.rescaleShader))
 		return false;
 
+	if (settings->video.rescaleShader == "bicubic" && !createWeightTexture(videoPanel, settings->video.rescaleFilter, settings->video.lanczosSize))
+		return false;
+
+	if (settings->map.rescaleShader == "bicubic" && !createWeightTexture(mapPanel, settings->map.rescaleFilter, settings->map.lanczosSize))
+		return false;
+
+	// the video panel is a single axis aligned quad, so it can be rescaled in two one dimensional passes
+	useSeparableRescale = (settings->video.rescaleShader == "bicubic");
+
+	if (useSeparableRescale && !loadSeparableRescaleShader())
+	{
+		qWarning("Could not load separable rescale shader, rescaling in one pass");
+		useSeparableRescale = false;
+	}
+
+	if (!loadRouteShader())
+	{
+		qWarning("Could not load route shader");
+		return false;
+	}
+
+	if (!loadInfoPanelShader())
+	{
+		qWarning("Could not load info panel shader");
+		return false;
+	}
+
 	paintDevice = new QOpenGLPaintDevice(windowWidth, windowHeight);
 	paintDevice->setPaintFlipped(renderToOffscreen);
 	painter = new QPainter();
@@ -149,10 +344,38 @@ bool Renderer::windowResized(int newWidth, int newHeight)
 
 	fullClearRequested = true;
 
+	if (renderInSoftware)
+	{
+		softwareCompositor.resize(windowWidth, windowHeight);
+		return createReadbackBuffers();
+	}
+
+	isMapCacheValid = false;
+
+	if (mapCacheFramebuffer != nullptr)
+	{
+		delete mapCacheFramebuffer;
+		mapCacheFramebuffer = nullptr;
+	}
+
+	if (useMapCache)
+	{
+		// the route needs the stencil
+		mapCacheFramebuffer = new QOpenGLFramebufferObject(windowWidth, windowHeight, QOpenGLFramebufferObject::CombinedDepthStencil);
+
+		if (!mapCacheFramebuffer->isValid())
+		{
+			qWarning("Could not create map cache frame buffer, drawing the map every frame");
+			delete mapCacheFramebuffer;
+			mapCacheFramebuffer = nullptr;
+			useMapCache = false;
+		}
+	}
+
 	if (renderToOffscreen)
 	{
 		QOpenGLFramebufferObjectFormat format;
-		format.setSamples(multisamples);
+		format.setSamples((antialiasingMode == "multisample") ? multisamples : 0);
 		format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
 
 		if (offscreenFramebuffer != nullptr)
@@ -185,18 +408,59 @@ bool Renderer::windowResized(int newWidth, int newHeight)
 			return false;
 		}
 
-		if (renderedFrameData.data != nullptr)
+		if (overlayFramebuffer != nullptr)
+		{
+			delete overlayFramebuffer;
+			overlayFramebuffer = nullptr;
+		}
+
+		if (overlayFramebufferNonMultisample != nullptr)
+		{
+			delete overlayFramebufferNonMultisample;
+			overlayFramebufferNonMultisample = nullptr;
+		}
+
+		if (antialiasingMode == "overlay")
+		{
+			// the paint engine needs the stencil for filling paths
+			format.setSamples(multisamples);
+			overlayFramebuffer = new QOpenGLFramebufferObject(windowWidth, windowHeight, format);
+
+			format.setSamples(0);
+			format.setAttachment(QOpenGLFramebufferObject::NoAttachment);
+			overlayFramebufferNonMultisample = new QOpenGLFramebufferObject(windowWidth, windowHeight, format);
+
+			if (!overlayFramebuffer->isValid() || !overlayFramebufferNonMultisample->isValid())
+			{
+				qWarning("Could not create overlay frame buffers");
+				return false;
+			}
+		}
+
+		if (yuvFramebuffer != nullptr)
+		{
+			delete yuvFramebuffer;
+			yuvFramebuffer = nullptr;
+		}
+
+		// the planes are packed into rows of full width, so the chroma planes need a height divisible by four
+		isConvertingToYuv = useYuvConversion && ((int)windowWidth % 2 == 0) && ((int)windowHeight % 4 == 0);
+
+		if (isConvertingToYuv)
 		{
-			delete renderedFrameData.data;
-			renderedFrameData.data = nullptr;
+			yuvFramebuffer = new QOpenGLFramebufferObject(windowWidth, windowHeight * 3 / 2, QOpenGLFramebufferObject::NoAttachment, GL_TEXTURE_2D, GL_R8);
+
+			if (!yuvFramebuffer->isValid())
+			{
+				qWarning("Could not create YUV frame buffer, converting on the CPU");
+				delete yuvFramebuffer;
+				yuvFramebuffer = nullptr;
+				isConvertingToYuv = false;
+			}
 		}
 
-		renderedFrameData = FrameData();
-		renderedFrameData.dataLength = (size_t)(windowWidth * windowHeight * 4);
-		renderedFrameData.rowLength = (size_t)(windowWidth * 4);
-		renderedFrameData.data = new uint8_t[renderedFrameData.dataLength];
-		renderedFrameData.width = windowWidth;
-		renderedFrameData.height = windowHeight;
+		if (!createReadbackBuffers())
+			return false;
 	}
 
 	return true;
@@ -204,10 +468,43 @@ bool Renderer::windowResized(int newWidth, int newHeight)
 
 Renderer::~Renderer()
 {
-	if (renderedFrameData.data != nullptr)
+	deleteUploadBuffers();
+	deleteReadbackBuffers();
+
+	if (rescaleFramebuffer != nullptr)
+	{
+		delete rescaleFramebuffer;
+		rescaleFramebuffer = nullptr;
+	}
+
+	if (infoPanelTexture != nullptr)
+	{
+		delete infoPanelTexture;
+		infoPanelTexture = nullptr;
+	}
+
+	if (yuvFramebuffer != nullptr)
+	{
+		delete yuvFramebuffer;
+		yuvFramebuffer = nullptr;
+	}
+
+	if (mapCacheFramebuffer != nullptr)
+	{
+		delete mapCacheFramebuffer;
+		mapCacheFramebuffer = nullptr;
+	}
+
+	if (overlayFramebufferNonMultisample != nullptr)
+	{
+		delete overlayFramebufferNonMultisample;
+		overlayFramebufferNonMultisample = nullptr;
+	}
+
+	if (overlayFramebuffer != nullptr)
 	{
-		delete renderedFrameData.data;
-		renderedFrameData.data = nullptr;
+		delete overlayFramebuffer;
+		overlayFramebuffer = nullptr;
 	}
 
 	if (offscreenFramebufferNonMultisample != nullptr)
@@ -237,23 +534,20 @@ Renderer::~Renderer()
 
 bool Renderer::loadRescaleShader(Panel& panel, const QString& shaderName)
 {
-	if (!panel.shaderProgram.addShaderFromSourceFile(QOpenGLShader::Vertex, QString("data/shaders/rescale_%1.vert").arg(shaderName)))
-		return false;
-
-	if (!panel.shaderProgram.addShaderFromSourceFile(QOpenGLShader::Fragment, QString("data/shaders/rescale_%1.frag").arg(shaderName)))
-		return false;
+	// both panels get the same program when they use the same shader, each keeps its own vertex array object
+	panel.shaderProgram = shaderCache.getProgram(QString("rescale_%1").arg(shaderName), QString("rescale_%1").arg(shaderName));
 
-	if (!panel.shaderProgram.link())
+	if (panel.shaderProgram == nullptr)
 		return false;
 
 	panel.vertexArrayObject.create();
 	panel.vertexArrayObject.bind();
 
 	panel.vertexBuffer.bind();
-	panel.shaderProgram.enableAttributeArray("vertexPosition");
-	panel.shaderProgram.enableAttributeArray("vertexTextureCoordinate");
-	panel.shaderProgram.setAttributeBuffer("vertexPosition", GL_FLOAT, 0, 3, 0);
-	panel.shaderProgram.setAttributeBuffer("vertexTextureCoordinate", GL_FLOAT, sizeof(GLfloat) * 12, 2, 0);
+	panel.shaderProgram->enableAttributeArray("vertexPosition");
+	panel.shaderProgram->enableAttributeArray("vertexTextureCoordinate");
+	panel.shaderProgram->setAttributeBuffer("vertexPosition", GL_FLOAT, 0, 3, 0);
+	panel.shaderProgram->setAttributeBuffer("vertexTextureCoordinate", GL_FLOAT, sizeof(GLfloat) * 12, 2, 0);
 
 	panel.vertexArrayObject.release();
 	panel.vertexBuffer.release();
@@ -261,6 +555,190 @@ bool Renderer::loadRescaleShader(Panel& panel, const QString& shaderName)
 	return true;
 }
 
+bool Renderer::createWeightTexture(Panel& panel, const QString& filterName, double lanczosSize)
+{
+	std::vector<float> weights(weightCount);
+
+	for (int i = 0; i < weightCount; ++i)
+		weights[i] = (float)interpolationWeight(filterName, std::max(1.0, lanczosSize), filterRange * i / (weightCount - 1));
+
+	panel.weightTexture.create();
+	panel.weightTexture.bind();
+	panel.weightTexture.setSize(weightCount, 1);
+	panel.weightTexture.setFormat(QOpenGLTexture::R32F);
+	panel.weightTexture.setMinificationFilter(QOpenGLTexture::Linear);
+	panel.weightTexture.setMagnificationFilter(QOpenGLTexture::Linear);
+	panel.weightTexture.setWrapMode(QOpenGLTexture::ClampToEdge);
+	panel.weightTexture.allocateStorage();
+	panel.weightTexture.setData(QOpenGLTexture::Red, QOpenGLTexture::Float32, weights.data());
+	panel.weightTexture.release();
+
+	if (!panel.weightTexture.isStorageAllocated())
+	{
+		qWarning("Could not create rescale weight texture");
+		return false;
+	}
+
+	return true;
+}
+
+bool Renderer::loadSeparableRescaleShader()
+{
+	// compiling the default tap count up front catches broken shader files at startup
+	QOpenGLShaderProgram* horizontalProgram = getRescaleProgram("rescale_bicubic_horizontal", "rescale_bicubic_horizontal", getTapCount(1.0));
+
+	if (horizontalProgram == nullptr)
+		return false;
+
+	if (getRescaleProgram("rescale_bicubic", "rescale_bicubic_vertical", getTapCount(1.0)) == nullptr)
+		return false;
+
+	// full screen quad
+	GLfloat rescaleBuffer[] =
+	{
+		-1.0f, 1.0f,
+		1.0f, 1.0f,
+		1.0f, -1.0f,
+		-1.0f, -1.0f
+	};
+
+	rescaleVertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+	rescaleVertexBuffer.create();
+	rescaleVertexBuffer.bind();
+	rescaleVertexBuffer.allocate(rescaleBuffer, sizeof(GLfloat) * 8);
+
+	rescaleVertexArrayObject.create();
+	rescaleVertexArrayObject.bind();
+
+	horizontalProgram->enableAttributeArray("vertexPosition");
+	horizontalProgram->setAttributeBuffer("vertexPosition", GL_FLOAT, 0, 2, 0);
+
+	rescaleVertexArrayObject.release();
+	rescaleVertexBuffer.release();
+
+	return true;
+}
+
+QOpenGLShaderProgram* Renderer::getRescaleProgram(const QString& vertexShaderName, const QString& fragmentShaderName, int tapCount)
+{
+	// the shader cache gives every variant the same attribute locations, so they all work with the vertex array objects set up for the first one and for the video panel
+	return shaderCache.getProgram(vertexShaderName, fragmentShaderName, QString("#define TAP_COUNT %1\n").arg(tapCount).toLatin1());
+}
+
+bool Renderer::loadRouteShader()
+{
+	routeShaderProgram = shaderCache.getProgram("route", "route");
+
+	if (routeShaderProgram == nullptr)
+		return false;
+
+	// the vertex data itself is uploaded on first use, the route isn't loaded yet at this point
+	auto createRouteVertexArray = [this](QOpenGLVertexArrayObject& vertexArrayObject, QOpenGLBuffer& vertexBuffer, QOpenGLBuffer::UsagePattern usagePattern)
+	{
+		vertexBuffer.setUsagePattern(usagePattern);
+		vertexBuffer.create();
+		vertexBuffer.bind();
+
+		vertexArrayObject.create();
+		vertexArrayObject.bind();
+
+		routeShaderProgram->enableAttributeArray("vertexPosition");
+		routeShaderProgram->enableAttributeArray("vertexOffset");
+		routeShaderProgram->enableAttributeArray("vertexShapeCoordinate");
+		routeShaderProgram->enableAttributeArray("vertexColor");
+		routeShaderProgram->setAttributeBuffer("vertexPosition", GL_FLOAT, offsetof(RouteVertex, x), 2, sizeof(RouteVertex));
+		routeShaderProgram->setAttributeBuffer("vertexOffset", GL_FLOAT, offsetof(RouteVertex, offsetX), 2, sizeof(RouteVertex));
+		routeShaderProgram->setAttributeBuffer("vertexShapeCoordinate", GL_FLOAT, offsetof(RouteVertex, u), 2, sizeof(RouteVertex));
+		routeShaderProgram->setAttributeBuffer("vertexColor", GL_FLOAT, offsetof(RouteVertex, paceR), 4, sizeof(RouteVertex));
+
+		vertexArrayObject.release();
+		vertexBuffer.release();
+	};
+
+	createRouteVertexArray(routeVertexArrayObject, routeVertexBuffer, QOpenGLBuffer::StaticDraw);
+	createRouteVertexArray(overlayShapeVertexArrayObject, overlayShapeVertexBuffer, QOpenGLBuffer::StreamDraw);
+	createRouteVertexArray(ghostTailVertexArrayObject, ghostTailVertexBuffer, QOpenGLBuffer::StaticDraw);
+	createRouteVertexArray(ghostFrameVertexArrayObject, ghostFrameVertexBuffer, QOpenGLBuffer::StreamDraw);
+
+	return true;
+}
+
+bool Renderer::loadInfoPanelShader()
+{
+	infoPanelShaderProgram = shaderCache.getProgram("info_panel", "info_panel");
+
+	if (infoPanelShaderProgram == nullptr)
+		return false;
+
+	infoPanelVertexBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+	infoPanelVertexBuffer.create();
+	infoPanelVertexBuffer.bind();
+
+	infoPanelVertexArrayObject.create();
+	infoPanelVertexArrayObject.bind();
+
+	infoPanelShaderProgram->enableAttributeArray("vertexPosition");
+	infoPanelShaderProgram->enableAttributeArray("vertexTextureCoordinate");
+	infoPanelShaderProgram->enableAttributeArray("vertexColor");
+	infoPanelShaderProgram->setAttributeBuffer("vertexPosition", GL_FLOAT, offsetof(InfoPanelVertex, x), 2, sizeof(InfoPanelVertex));
+	infoPanelShaderProgram->setAttributeBuffer("vertexTextureCoordinate", GL_FLOAT, offsetof(InfoPanelVertex, u), 2, sizeof(InfoPanelVertex));
+	infoPanelShaderProgram->setAttributeBuffer("vertexColor", GL_FLOAT, offsetof(InfoPanelVertex, r), 4, sizeof(InfoPanelVertex));
+
+	infoPanelVertexArrayObject.release();
+	infoPanelVertexBuffer.release();
+
+	const QImage& atlasImage = infoPanel.getAtlasImage();
+
+	// premultiplied ARGB words are BGRA bytes, so the atlas goes up as is
+	infoPanelTexture = new QOpenGLTexture(QOpenGLTexture::Target2D);
+	infoPanelTexture->create();
+	infoPanelTexture->bind();
+	infoPanelTexture->setSize(atlasImage.width(), atlasImage.height());
+	infoPanelTexture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+	infoPanelTexture->setMinificationFilter(QOpenGLTexture::Nearest);
+	infoPanelTexture->setMagnificationFilter(QOpenGLTexture::Nearest);
+	infoPanelTexture->setWrapMode(QOpenGLTexture::ClampToEdge);
+	infoPanelTexture->allocateStorage();
+	infoPanelTexture->setData(QOpenGLTexture::BGRA, QOpenGLTexture::UInt8, atlasImage.constBits());
+	infoPanelTexture->release();
+
+	return true;
+}
+
+bool Renderer::loadOverlayShader()
+{
+	overlayShaderProgram = shaderCache.getProgram("overlay", "overlay");
+
+	if (overlayShaderProgram == nullptr)
+		return false;
+
+	// 4 3
+	// 1 2
+	GLfloat overlayBuffer[] =
+	{
+		0.0f, 0.0f,
+		1.0f, 0.0f,
+		1.0f, 1.0f,
+		0.0f, 1.0f
+	};
+
+	overlayVertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+	overlayVertexBuffer.create();
+	overlayVertexBuffer.bind();
+	overlayVertexBuffer.allocate(overlayBuffer, sizeof(GLfloat) * 8);
+
+	overlayVertexArrayObject.create();
+	overlayVertexArrayObject.bind();
+
+	overlayShaderProgram->enableAttributeArray("vertexPosition");
+	overlayShaderProgram->setAttributeBuffer("vertexPosition", GL_FLOAT, 0, 2, 0);
+
+	overlayVertexArrayObject.release();
+	overlayVertexBuffer.release();
+
+	return true;
+}
+
 void Renderer::startRendering(double currentTime, double frameDuration, double decodeDuration, double stabilizeDuration, double encodeDuration, double spareTime)
 {
 	renderDurationTimer.restart();
@@ -271,10 +749,16 @@ void Renderer::startRendering(double currentTime, double frameDuration, double d
 	averageFrameDuration.addMeasurement(frameDuration, frameDuration);
 	averageDecodeDuration.addMeasurement(decodeDuration, frameDuration);
 	averageStabilizeDuration.addMeasurement(stabilizeDuration, frameDuration);
+	averageStabilizeAnalyzeDuration.addMeasurement(videoStabilizer->getAnalyzeDuration(), frameDuration);
 	averageRenderDuration.addMeasurement(renderDuration, frameDuration);
 	averageEncodeDuration.addMeasurement(encodeDuration, frameDuration);
 	averageSpareTime.addMeasurement(spareTime, frameDuration);
 
+	if (renderInSoftware)
+		return;
+
+	gpuTimer.startFrame();
+
 	paintDevice->setSize(QSize(windowWidth, windowHeight));
 
 	glViewport(0, 0, windowWidth, windowHeight);
@@ -284,29 +768,113 @@ void Renderer::startRendering(double currentTime, double frameDuration, double d
 
 void Renderer::uploadFrameData(const FrameData& frameData)
 {
-	if (frameData.data != nullptr && frameData.width > 0 && frameData.height > 0)
+	if (frameData.data == nullptr || frameData.width <= 0 || frameData.height <= 0)
+		return;
+
+	if (renderInSoftware)
+	{
+		softwareCompositor.setVideoFrame(frameData);
+		return;
+	}
+
+	if (uploadBufferCount > 0 && frameData.width == (int)videoPanel.textureWidth && frameData.height == (int)videoPanel.textureHeight)
 	{
-		QOpenGLPixelTransferOptions options;
+		UploadBuffer& uploadBuffer = uploadBuffers[uploadWriteIndex];
+		uploadWriteIndex = (uploadWriteIndex + 1) % uploadBufferCount;
+
+		// the slot was last used a couple of frames ago, so the texture update reading it has normally finished already
+		if (uploadBuffer.fence != nullptr)
+		{
+			while (coreFunctions->glClientWaitSync(uploadBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+
+			coreFunctions->glDeleteSync(uploadBuffer.fence);
+			uploadBuffer.fence = nullptr;
+		}
+
+		int uploadRowLength = frameData.width * 4;
+		int uploadDataLength = uploadRowLength * frameData.height;
+
+		uploadBuffer.pixelBuffer.bind();
+
+		uint8_t* destination = uploadBuffer.mappedData;
+
+		// without persistent mapping orphan the old storage so that the driver doesn't have to wait for pending reads
+		if (destination == nullptr)
+		{
+			uploadBuffer.pixelBuffer.allocate(uploadDataLength);
+			destination = (uint8_t*)coreFunctions->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)uploadDataLength, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		}
+
+		if (destination != nullptr)
+		{
+			if (frameData.rowLength == uploadRowLength)
+				memcpy(destination, frameData.data, uploadDataLength);
+			else
+			{
+				for (int y = 0; y < frameData.height; ++y)
+					memcpy(destination + y * uploadRowLength, frameData.data + y * frameData.rowLength, uploadRowLength);
+			}
+
+			if (uploadBuffer.mappedData == nullptr)
+				coreFunctions->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			// the pixels are sourced from the bound buffer, so this returns right away and the copy happens on the GPU timeline
+			videoPanel.texture.bind();
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frameData.width, frameData.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			videoPanel.texture.release();
+
+			uploadBuffer.fence = coreFunctions->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		else
+			qWarning("Could not map upload pixel buffer");
 
-		options.setRowLength((int)(frameData.rowLength / 4));
-		options.setImageHeight(frameData.height);
-		options.setAlignment(1);
+		uploadBuffer.pixelBuffer.release();
 
-		videoPanel.texture.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, frameData.data, &options);
+		if (destination != nullptr)
+			return;
 	}
+
+	QOpenGLPixelTransferOptions options;
+
+	options.setRowLength((int)(frameData.rowLength / 4));
+	options.setImageHeight(frameData.height);
+	options.setAlignment(1);
+
+	videoPanel.texture.setData(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, frameData.data, &options);
 }
 
 void Renderer::renderAll()
 {
+	if (renderInSoftware)
+	{
+		renderAllInSoftware();
+		return;
+	}
+
 	if (renderToOffscreen)
 		offscreenFramebuffer->bind();
 
 	if (renderMode == RenderMode::All || renderMode == RenderMode::Video)
+	{
+		gpuTimer.begin(GpuTimerPass::VideoPanel);
 		renderVideoPanel();
+		gpuTimer.end(GpuTimerPass::VideoPanel);
+	}
 
 	if (renderMode == RenderMode::All || renderMode == RenderMode::Map)
 	{
-		renderMapPanel();
+		// the cached layer times its own parts, the route line in it belongs to the route pass
+		if (useMapCache)
+			renderCachedMapLayer(routeManager->getDefaultRoute());
+		else
+		{
+			gpuTimer.begin(GpuTimerPass::MapPanel);
+			renderMapPanel();
+			gpuTimer.end(GpuTimerPass::MapPanel);
+		}
+
 		renderRoute(routeManager->getDefaultRoute());
 
 		if (mapPanel.clippingEnabled)
@@ -321,43 +889,702 @@ void Renderer::renderAll()
 	}
 
 	if (showInfoPanel)
+	{
+		gpuTimer.begin(GpuTimerPass::InfoPanel);
 		renderInfoPanel();
+		gpuTimer.end(GpuTimerPass::InfoPanel);
+	}
 
 	if (renderToOffscreen)
 		offscreenFramebuffer->release();
 }
 
-void Renderer::stopRendering()
+void Renderer::renderAllInSoftware()
 {
-	renderDuration = renderDurationTimer.nsecsElapsed() / 1000000.0;
-}
+	updateVideoPanelMatrix();
+	updateMapPanelMatrix();
 
-FrameData Renderer::getRenderedFrame()
-{
-	if (!renderToOffscreen)
-		return FrameData();
+	Route& route = routeManager->getDefaultRoute();
+	QMatrix routePainterMatrix = getRoutePainterMatrix();
+	double mapScale = mapPanel.scale * mapPanel.userScale * routeManager->getScale();
+	const QImage& mapImage = softwareCompositor.getMapImage(mapScale);
 
-	QOpenGLFramebufferObject* sourceFbo = offscreenFramebuffer;
+	if (showInfoPanel)
+	{
+		updateInfoPanel();
+		infoPanel.updateVertices();
+	}
 
-	// pixels cannot be directly read from a multisampled framebuffer
-	// copy the framebuffer to a non-multisampled framebuffer and continue
-	if (sourceFbo->format().samples() != 0)
+	if (fullClearRequested)
 	{
-		QRect rect(0, 0, windowWidth, windowHeight);
-		QOpenGLFramebufferObject::blitFramebuffer(offscreenFramebufferNonMultisample, rect, sourceFbo, rect);
-		sourceFbo = offscreenFramebufferNonMultisample;
+		// the encoder ignores alpha, and a transparent clear color would lose its color channels when premultiplied
+		QColor clearColor = (renderMode == RenderMode::Map) ? mapPanel.clearColor : videoPanel.clearColor;
+		softwareCompositor.getImage().fill(QColor(clearColor.rgb()));
+		fullClearRequested = false;
 	}
 
-	sourceFbo->bind();
-	glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, renderedFrameData.data);
-	sourceFbo->release();
+	// the panel bands and the overlay are painted in parallel, so everything they share is set up before this and only read in here
+	if (softwareRoutePath.elementCount() == 0 || softwareRouteLevel != route.routeLevel)
+	{
+		softwareRoutePath = QPainterPath();
+		softwareRouteLevel = route.routeLevel;
 
-	return renderedFrameData;
-}
+		for (int i : getRouteLevelPointIndices(route))
+		{
+			if (softwareRoutePath.elementCount() == 0)
+				softwareRoutePath.moveTo(route.routePoints.at(i).position);
+			else
+				softwareRoutePath.lineTo(route.routePoints.at(i).position);
+		}
+	}
 
-void Renderer::renderVideoPanel()
-{
-	videoPanel.vertexMatrix.setToIdentity();
+	auto paintPanels = [&](QPainter* bandPainter)
+	{
+		if (renderMode == RenderMode::All || renderMode == RenderMode::Video)
+			paintPanel(bandPainter, videoPanel, softwareCompositor.getVideoImage(), videoPanel.clippingEnabled ? getVideoPanelClipRect() : QRect(0, 0, (int)windowWidth, (int)windowHeight));
+
+		if (renderMode == RenderMode::All || renderMode == RenderMode::Map)
+			paintPanel(bandPainter, mapPanel, mapImage, QRect(0, 0, (int)(mapPanel.clippingEnabled ? (mapPanel.relativeWidth * windowWidth + 0.5) : windowWidth), (int)windowHeight));
+	};
+
+	// the paths are only touched by the one thread painting the overlay
+	auto paintOverlay = [&](QPainter* overlayPainter)
+	{
+		if (renderMode == RenderMode::All || renderMode == RenderMode::Map)
+		{
+			paintRouteLine(overlayPainter, route, routePainterMatrix);
+			paintGhostRoutes(overlayPainter, routePainterMatrix);
+			paintRouteOverlay(overlayPainter, route, routePainterMatrix);
+
+			if (mapPanel.clippingEnabled)
+			{
+				int mapRightBorderX = (int)(mapPanel.relativeWidth * windowWidth + 0.5);
+
+				overlayPainter->setPen(QColor(0, 0, 0));
+				overlayPainter->drawLine(mapRightBorderX, 0, mapRightBorderX, (int)windowHeight);
+			}
+		}
+
+		if (showInfoPanel)
+			infoPanel.paint(overlayPainter);
+	};
+
+	softwareCompositor.render(paintPanels, paintOverlay);
+}
+
+void Renderer::paintPanel(QPainter* panelPainter, Panel& panel, const QImage& image, const QRect& clipRect)
+{
+	if (image.isNull())
+		return;
+
+	// panel vertices are centered with the image top at +y, the matrix takes them to clip space and the last step to image rows
+	QTransform imageTransform(panel.textureWidth / image.width(), 0.0, 0.0, -panel.textureHeight / image.height(), -panel.textureWidth / 2.0, panel.textureHeight / 2.0);
+	QTransform viewportTransform(windowWidth / 2.0, 0.0, 0.0, windowHeight / 2.0, windowWidth / 2.0, windowHeight / 2.0);
+
+	panelPainter->save();
+	panelPainter->setClipRect(clipRect);
+
+	// panels replace what's under them like the GL path, which draws them without blending
+	panelPainter->setCompositionMode(QPainter::CompositionMode_Source);
+
+	if (panel.clearingEnabled)
+		panelPainter->fillRect(clipRect, QColor(panel.clearColor.rgb()));
+	panelPainter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+	panelPainter->setTransform(imageTransform * panel.vertexMatrix.toTransform() * viewportTransform, true);
+	panelPainter->drawImage(QPointF(0.0, 0.0), image);
+	panelPainter->restore();
+}
+
+std::vector<int> Renderer::getRouteLevelPointIndices(const Route& route) const
+{
+	std::vector<int> pointIndices;
+	double tolerance = route.routeLevels.empty() ? 0.0 : route.routeLevels.at(route.routeLevel).tolerance;
+
+	for (int i = 0; i < (int)route.routePoints.size(); ++i)
+	{
+		if (route.routePointSignificances.at(i) >= tolerance)
+			pointIndices.push_back(i);
+	}
+
+	return pointIndices;
+}
+
+void Renderer::paintRouteLine(QPainter* routePainter, Route& route, const QMatrix& painterMatrix)
+{
+	if (route.routeRenderMode == RouteRenderMode::None)
+		return;
+
+	routePainter->save();
+	routePainter->setRenderHints(QPainter::Antialiasing | QPainter::HighQualityAntialiasing);
+
+	if (renderMode != RenderMode::Map)
+		routePainter->setClipRect(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
+
+	routePainter->setWorldMatrix(painterMatrix, true);
+
+	QPen routePen;
+	routePen.setWidthF(route.routeWidth * route.userScale);
+	routePen.setJoinStyle(Qt::PenJoinStyle::RoundJoin);
+	routePen.setCapStyle(Qt::PenCapStyle::RoundCap);
+	routePainter->setBrush(Qt::NoBrush);
+
+	if (route.routeRenderMode == RouteRenderMode::Pace)
+	{
+		std::vector<int> pointIndices = getRouteLevelPointIndices(route);
+
+		// a gradient per segment matches the per-vertex colors of the GL path
+		for (int i = 0; i < (int)pointIndices.size() - 1; ++i)
+		{
+			const RoutePoint& rp1 = route.routePoints.at(pointIndices.at(i));
+			const RoutePoint& rp2 = route.routePoints.at(pointIndices.at(i + 1));
+
+			QLinearGradient gradient(rp1.position, rp2.position);
+			gradient.setColorAt(0.0, rp1.color);
+			gradient.setColorAt(1.0, rp2.color);
+
+			routePen.setBrush(gradient);
+			routePainter->setPen(routePen);
+			routePainter->drawLine(rp1.position, rp2.position);
+		}
+	}
+	else
+	{
+		routePen.setColor(route.routeRenderMode == RouteRenderMode::Discreet ? route.discreetColor : route.highlightColor);
+		routePainter->setPen(routePen);
+		routePainter->drawPath(softwareRoutePath);
+	}
+
+	routePainter->restore();
+}
+
+void Renderer::stopRendering()
+{
+	renderDuration = renderDurationTimer.nsecsElapsed() / 1000000.0;
+}
+
+bool Renderer::loadYuvConversionShader()
+{
+	yuvShaderProgram = shaderCache.getProgram("convert_i420", "convert_i420");
+
+	if (yuvShaderProgram == nullptr)
+		return false;
+
+	// full screen quad
+	GLfloat yuvBuffer[] =
+	{
+		-1.0f, 1.0f,
+		1.0f, 1.0f,
+		1.0f, -1.0f,
+		-1.0f, -1.0f
+	};
+
+	yuvVertexBuffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+	yuvVertexBuffer.create();
+	yuvVertexBuffer.bind();
+	yuvVertexBuffer.allocate(yuvBuffer, sizeof(GLfloat) * 8);
+
+	yuvVertexArrayObject.create();
+	yuvVertexArrayObject.bind();
+
+	yuvShaderProgram->enableAttributeArray("vertexPosition");
+	yuvShaderProgram->setAttributeBuffer("vertexPosition", GL_FLOAT, 0, 2, 0);
+
+	yuvVertexArrayObject.release();
+	yuvVertexBuffer.release();
+
+	return true;
+}
+
+void Renderer::convertToYuv(QOpenGLFramebufferObject* sourceFbo)
+{
+	yuvFramebuffer->bind();
+	glViewport(0, 0, windowWidth, windowHeight * 3 / 2);
+	glDisable(GL_BLEND);
+	glDisable(GL_SCISSOR_TEST);
+
+	yuvShaderProgram->bind();
+	yuvShaderProgram->setUniformValue("textureSampler", 0);
+	yuvShaderProgram->setUniformValue("textureWidth", (float)windowWidth);
+	yuvShaderProgram->setUniformValue("textureHeight", (float)windowHeight);
+
+	// the chroma taps fall between texels and rely on linear filtering
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, sourceFbo->texture());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	yuvVertexArrayObject.bind();
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+	yuvVertexArrayObject.release();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	yuvShaderProgram->release();
+	yuvFramebuffer->release();
+}
+
+int Renderer::getReadbackDataLength() const
+{
+	if (isConvertingToYuv)
+		return (int)(windowWidth * windowHeight * 3 / 2);
+	else
+		return (int)(windowWidth * windowHeight * 4);
+}
+
+bool Renderer::createUploadBuffers()
+{
+	deleteUploadBuffers();
+
+	int dataLength = (int)videoPanel.textureWidth * (int)videoPanel.textureHeight * 4;
+
+	if (dataLength <= 0)
+		return true;
+
+	QOpenGLContext* context = QOpenGLContext::currentContext();
+	BufferStorageFunction bufferStorage = nullptr;
+
+	if (context->format().version() >= qMakePair(4, 4) || context->hasExtension("GL_ARB_buffer_storage"))
+		bufferStorage = (BufferStorageFunction)context->getProcAddress("glBufferStorage");
+
+	if (bufferStorage == nullptr)
+		qDebug("Persistent buffer mapping is not available, orphaning upload buffers instead");
+
+	uploadBufferCount = maxUploadBufferCount;
+
+	for (int i = 0; i < uploadBufferCount; ++i)
+	{
+		UploadBuffer& uploadBuffer = uploadBuffers[i];
+
+		if (!uploadBuffer.pixelBuffer.create())
+		{
+			qWarning("Could not create pixel buffer");
+			return false;
+		}
+
+		uploadBuffer.pixelBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+		uploadBuffer.pixelBuffer.bind();
+
+		if (bufferStorage != nullptr)
+		{
+			// coherent mapping makes the written pixels visible to the GPU without explicit flushes, the fences keep the slots apart
+			GLbitfield flags = GL_MAP_WRITE_BIT | mapPersistentBit | mapCoherentBit;
+
+			bufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)dataLength, nullptr, flags);
+			uploadBuffer.mappedData = (uint8_t*)coreFunctions->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)dataLength, flags);
+
+			if (uploadBuffer.mappedData == nullptr)
+			{
+				qWarning("Could not map upload pixel buffer");
+				uploadBuffer.pixelBuffer.release();
+				return false;
+			}
+		}
+		else
+			uploadBuffer.pixelBuffer.allocate(dataLength);
+
+		uploadBuffer.pixelBuffer.release();
+	}
+
+	return true;
+}
+
+void Renderer::deleteUploadBuffers()
+{
+	for (int i = 0; i < uploadBufferCount; ++i)
+	{
+		UploadBuffer& uploadBuffer = uploadBuffers[i];
+
+		if (uploadBuffer.fence != nullptr)
+		{
+			coreFunctions->glDeleteSync(uploadBuffer.fence);
+			uploadBuffer.fence = nullptr;
+		}
+
+		if (uploadBuffer.mappedData != nullptr)
+		{
+			uploadBuffer.pixelBuffer.bind();
+			coreFunctions->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			uploadBuffer.pixelBuffer.release();
+			uploadBuffer.mappedData = nullptr;
+		}
+
+		if (uploadBuffer.pixelBuffer.isCreated())
+			uploadBuffer.pixelBuffer.destroy();
+	}
+
+	uploadBufferCount = 0;
+	uploadWriteIndex = 0;
+}
+
+bool Renderer::createReadbackBuffers()
+{
+	deleteReadbackBuffers();
+
+	int dataLength = getReadbackDataLength();
+
+	// one slot is held by the encoder and the rest hold frames rendered ahead of it, as many as the memory budget allows
+	// two slots are the minimum for the encoder to read one while the other is written
+	int budgetFrameCount = (dataLength > 0) ? (int)(renderAheadMemoryBudget / dataLength) : maxReadbackBufferCount;
+	readbackBufferCount = std::max(2, std::min(std::min(renderAheadFrameCount + 1, budgetFrameCount), maxReadbackBufferCount));
+
+	qDebug("Rendering up to %d frames ahead of the encoder", readbackBufferCount - 1);
+
+	for (int i = 0; i < readbackBufferCount; ++i)
+	{
+		ReadbackBuffer& readbackBuffer = readbackBuffers[i];
+
+		if (coreFunctions != nullptr)
+		{
+			if (!readbackBuffer.pixelBuffer.create())
+			{
+				qWarning("Could not create pixel buffer");
+				return false;
+			}
+
+			readbackBuffer.pixelBuffer.setUsagePattern(QOpenGLBuffer::StreamRead);
+			readbackBuffer.pixelBuffer.bind();
+			readbackBuffer.pixelBuffer.allocate(dataLength);
+			readbackBuffer.pixelBuffer.release();
+		}
+		else
+			readbackBuffer.data = new uint8_t[dataLength];
+	}
+
+	return true;
+}
+
+void Renderer::deleteReadbackBuffers()
+{
+	releaseRenderedFrame();
+
+	for (int i = 0; i < readbackBufferCount; ++i)
+	{
+		ReadbackBuffer& readbackBuffer = readbackBuffers[i];
+
+		if (readbackBuffer.fence != nullptr)
+		{
+			coreFunctions->glDeleteSync(readbackBuffer.fence);
+			readbackBuffer.fence = nullptr;
+		}
+
+		if (readbackBuffer.pixelBuffer.isCreated())
+			readbackBuffer.pixelBuffer.destroy();
+
+		if (readbackBuffer.data != nullptr)
+		{
+			delete[] readbackBuffer.data;
+			readbackBuffer.data = nullptr;
+		}
+	}
+
+	readbackBufferCount = 0;
+	readbackWriteIndex = 0;
+	pendingReadbackCount = 0;
+}
+
+void Renderer::readRenderedFrame()
+{
+	if (!renderToOffscreen)
+		return;
+
+	// the caller must hand frames to the encoder before the ring runs out of free slots
+	if (pendingReadbackCount + ((mappedReadbackIndex >= 0) ? 1 : 0) >= readbackBufferCount)
+	{
+		qWarning("Readback ring is full, dropping the frame");
+		return;
+	}
+
+	if (renderInSoftware)
+	{
+		// the composited image is already top row first and in the byte order the encoder wants
+		memcpy(readbackBuffers[readbackWriteIndex].data, softwareCompositor.getOutputImage().constBits(), getReadbackDataLength());
+
+		readbackWriteIndex = (readbackWriteIndex + 1) % readbackBufferCount;
+		pendingReadbackCount++;
+
+		return;
+	}
+
+	QOpenGLFramebufferObject* sourceFbo = offscreenFramebuffer;
+
+	// pixels cannot be directly read from a multisampled framebuffer
+	// copy the framebuffer to a non-multisampled framebuffer and continue
+	if (sourceFbo->format().samples() != 0)
+	{
+		QRect rect(0, 0, windowWidth, windowHeight);
+
+		gpuTimer.begin(GpuTimerPass::Resolve);
+		QOpenGLFramebufferObject::blitFramebuffer(offscreenFramebufferNonMultisample, rect, sourceFbo, rect);
+		gpuTimer.end(GpuTimerPass::Resolve);
+
+		sourceFbo = offscreenFramebufferNonMultisample;
+	}
+
+	ReadbackBuffer& readbackBuffer = readbackBuffers[readbackWriteIndex];
+
+	gpuTimer.begin(GpuTimerPass::Readback);
+
+	// the encoder wants I420, converting on the GPU also shrinks the readback from 4 to 1.5 bytes per pixel
+	if (isConvertingToYuv)
+	{
+		convertToYuv(sourceFbo);
+		sourceFbo = yuvFramebuffer;
+	}
+
+	GLenum readFormat = isConvertingToYuv ? GL_RED : GL_RGBA;
+	int readHeight = isConvertingToYuv ? (int)(windowHeight * 3 / 2) : (int)windowHeight;
+
+	sourceFbo->bind();
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	// with a pixel buffer bound the read only queues a copy on the GPU and returns immediately
+	if (coreFunctions != nullptr)
+	{
+		readbackBuffer.pixelBuffer.bind();
+		glReadPixels(0, 0, windowWidth, readHeight, readFormat, GL_UNSIGNED_BYTE, nullptr);
+		readbackBuffer.pixelBuffer.release();
+		readbackBuffer.fence = coreFunctions->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	else
+		glReadPixels(0, 0, windowWidth, readHeight, readFormat, GL_UNSIGNED_BYTE, readbackBuffer.data);
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	sourceFbo->release();
+
+	gpuTimer.end(GpuTimerPass::Readback);
+
+	readbackWriteIndex = (readbackWriteIndex + 1) % readbackBufferCount;
+	pendingReadbackCount++;
+}
+
+bool Renderer::getRenderedFrame(FrameData& frameData)
+{
+	if (!renderToOffscreen || pendingReadbackCount == 0 || mappedReadbackIndex >= 0)
+		return false;
+
+	int readIndex = (readbackWriteIndex - pendingReadbackCount + readbackBufferCount) % readbackBufferCount;
+	ReadbackBuffer& readbackBuffer = readbackBuffers[readIndex];
+
+	frameData = FrameData();
+	frameData.dataLength = (size_t)getReadbackDataLength();
+	frameData.rowLength = isConvertingToYuv ? (size_t)windowWidth : (size_t)(windowWidth * 4);
+	frameData.width = windowWidth;
+	frameData.height = windowHeight;
+	frameData.isPlanarYuv = isConvertingToYuv;
+
+	if (coreFunctions != nullptr)
+	{
+		// the oldest readback has usually finished long ago, so this rarely waits
+		if (readbackBuffer.fence != nullptr)
+		{
+			while (coreFunctions->glClientWaitSync(readbackBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+
+			coreFunctions->glDeleteSync(readbackBuffer.fence);
+			readbackBuffer.fence = nullptr;
+		}
+
+		readbackBuffer.pixelBuffer.bind();
+		frameData.data = (uint8_t*)coreFunctions->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)frameData.dataLength, GL_MAP_READ_BIT);
+		readbackBuffer.pixelBuffer.release();
+
+		if (frameData.data == nullptr)
+		{
+			qWarning("Could not map pixel buffer");
+			pendingReadbackCount--;
+			return false;
+		}
+	}
+	else
+		frameData.data = readbackBuffer.data;
+
+	mappedReadbackIndex = readIndex;
+	pendingReadbackCount--;
+
+	return true;
+}
+
+void Renderer::releaseRenderedFrame()
+{
+	if (mappedReadbackIndex < 0)
+		return;
+
+	ReadbackBuffer& readbackBuffer = readbackBuffers[mappedReadbackIndex];
+
+	if (coreFunctions != nullptr && readbackBuffer.pixelBuffer.isCreated())
+	{
+		readbackBuffer.pixelBuffer.bind();
+		readbackBuffer.pixelBuffer.unmap();
+		readbackBuffer.pixelBuffer.release();
+	}
+
+	mappedReadbackIndex = -1;
+}
+
+int Renderer::getPendingReadbackCount() const
+{
+	return pendingReadbackCount;
+}
+
+int Renderer::getReadbackBufferCount() const
+{
+	return readbackBufferCount;
+}
+
+void Renderer::renderVideoPanel()
+{
+	updateVideoPanelMatrix();
+
+	if (useSeparableRescale)
+		rescaleVideoRows();
+
+	if (fullClearRequested)
+	{
+		glClearColor(videoPanel.clearColor.redF(), videoPanel.clearColor.greenF(), videoPanel.clearColor.blueF(), 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		fullClearRequested = false;
+	}
+
+	if (videoPanel.clippingEnabled)
+	{
+		QRect clipRect = getVideoPanelClipRect();
+
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(clipRect.x(), clipRect.y(), clipRect.width(), clipRect.height());
+	}
+
+	if (videoPanel.clearingEnabled)
+	{
+		glClearColor(videoPanel.clearColor.redF(), videoPanel.clearColor.greenF(), videoPanel.clearColor.blueF(), 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	if (useSeparableRescale)
+		renderRescaledVideoPanel();
+	else
+		renderPanel(videoPanel);
+
+	glDisable(GL_SCISSOR_TEST);
+}
+
+void Renderer::rescaleVideoRows()
+{
+	double displayWidth = videoPanel.textureWidth * videoPanel.scale * videoPanel.userScale;
+	double displayHeight = videoPanel.textureHeight * videoPanel.scale * videoPanel.userScale;
+
+	// when zooming in the rows stop growing at the window size, the second pass stretches them further with the hardware filter
+	int targetWidth = std::max(1, (int)(std::min(displayWidth, std::max(videoPanel.textureWidth, windowWidth)) + 0.5));
+	int targetHeight = (int)videoPanel.textureHeight;
+
+	rescaleFilterScaleX = std::min(std::max(videoPanel.textureWidth / displayWidth, 1.0), maxFilterScale);
+	rescaleFilterScaleY = std::min(std::max(videoPanel.textureHeight / displayHeight, 1.0), maxFilterScale);
+
+	if (rescaleFramebuffer == nullptr || rescaleFramebuffer->width() != targetWidth || rescaleFramebuffer->height() != targetHeight)
+	{
+		if (rescaleFramebuffer != nullptr)
+		{
+			delete rescaleFramebuffer;
+			rescaleFramebuffer = nullptr;
+		}
+
+		rescaleFramebuffer = new QOpenGLFramebufferObject(targetWidth, targetHeight);
+
+		if (!rescaleFramebuffer->isValid())
+		{
+			qWarning("Could not create rescale frame buffer, rescaling in one pass");
+			delete rescaleFramebuffer;
+			rescaleFramebuffer = nullptr;
+			useSeparableRescale = false;
+
+			if (renderToOffscreen)
+				offscreenFramebuffer->bind();
+
+			return;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, rescaleFramebuffer->texture());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	QOpenGLShaderProgram* program = getRescaleProgram("rescale_bicubic_horizontal", "rescale_bicubic_horizontal", getTapCount(rescaleFilterScaleX));
+
+	if (program == nullptr)
+	{
+		useSeparableRescale = false;
+		return;
+	}
+
+	rescaleFramebuffer->bind();
+	glViewport(0, 0, targetWidth, targetHeight);
+	glDisable(GL_BLEND);
+	glDisable(GL_SCISSOR_TEST);
+
+	program->bind();
+	program->setUniformValue("textureSampler", 0);
+	program->setUniformValue("weightSampler", 1);
+	program->setUniformValue("weightCount", (float)weightCount);
+	program->setUniformValue("sourceWidth", (float)videoPanel.textureWidth);
+	program->setUniformValue("targetWidth", (float)targetWidth);
+	program->setUniformValue("filterScale", (float)rescaleFilterScaleX);
+
+	videoPanel.weightTexture.bind(1, QOpenGLTexture::ResetTextureUnit);
+	videoPanel.texture.bind();
+
+	rescaleVertexArrayObject.bind();
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+	rescaleVertexArrayObject.release();
+
+	videoPanel.texture.release();
+	videoPanel.weightTexture.release(1, QOpenGLTexture::ResetTextureUnit);
+	program->release();
+
+	// back to whatever the panels are drawn into
+	if (renderToOffscreen)
+		offscreenFramebuffer->bind();
+	else
+		rescaleFramebuffer->release();
+
+	glViewport(0, 0, windowWidth, windowHeight);
+}
+
+void Renderer::renderRescaledVideoPanel()
+{
+	QOpenGLShaderProgram* program = getRescaleProgram("rescale_bicubic", "rescale_bicubic_vertical", getTapCount(rescaleFilterScaleY));
+
+	if (program == nullptr || rescaleFramebuffer == nullptr)
+	{
+		renderPanel(videoPanel);
+		return;
+	}
+
+	program->bind();
+	program->setUniformValue("vertexMatrix", videoPanel.vertexMatrix);
+	program->setUniformValue("textureSampler", 0);
+	program->setUniformValue("weightSampler", 1);
+	program->setUniformValue("weightCount", (float)weightCount);
+	program->setUniformValue("textureHeight", (float)videoPanel.textureHeight);
+	program->setUniformValue("filterScale", (float)rescaleFilterScaleY);
+
+	videoPanel.weightTexture.bind(1, QOpenGLTexture::ResetTextureUnit);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, rescaleFramebuffer->texture());
+
+	videoPanel.vertexArrayObject.bind();
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+	videoPanel.vertexArrayObject.release();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	videoPanel.weightTexture.release(1, QOpenGLTexture::ResetTextureUnit);
+	program->release();
+}
+
+void Renderer::updateVideoPanelMatrix()
+{
+	videoPanel.vertexMatrix.setToIdentity();
 
 	if (!renderToOffscreen)
 		videoPanel.vertexMatrix.ortho(-windowWidth / 2, windowWidth / 2, -windowHeight / 2, windowHeight / 2, 0.0f, 1.0f);
@@ -384,40 +1611,50 @@ void Renderer::renderVideoPanel()
 		videoPanel.y + videoPanel.userY - videoStabilizer->getY() * videoPanel.textureHeight * videoPanel.scale * videoPanel.userScale);
 	videoPanel.vertexMatrix.rotate(videoPanel.angle + videoPanel.userAngle - videoStabilizer->getAngle(), 0.0f, 0.0f, 1.0f);
 	videoPanel.vertexMatrix.scale(videoPanel.scale * videoPanel.userScale);
+}
+
+QRect Renderer::getVideoPanelClipRect() const
+{
+	double videoPanelWidth = videoPanel.scale * videoPanel.userScale * videoPanel.textureWidth;
+	double videoPanelHeight = videoPanel.scale * videoPanel.userScale * videoPanel.textureHeight;
+	double leftMargin = (windowWidth - videoPanelWidth) / 2.0;
+	double bottomMargin = (windowHeight - videoPanelHeight) / 2.0;
+
+	// framebuffer coordinates, which are also image rows when rendering offscreen since that output is flipped
+	return QRect((int)(leftMargin + videoPanel.x + videoPanel.userX + videoPanel.offsetX + 0.5),
+		(int)(bottomMargin + videoPanel.y + videoPanel.userY + videoPanel.offsetY + 0.5),
+		(int)(videoPanelWidth + 0.5),
+		(int)(videoPanelHeight + 0.5));
+}
+
+void Renderer::renderMapPanel()
+{
+	updateMapPanelMatrix();
 
 	if (fullClearRequested)
 	{
-		glClearColor(videoPanel.clearColor.redF(), videoPanel.clearColor.greenF(), videoPanel.clearColor.blueF(), 0.0f);
+		glClearColor(mapPanel.clearColor.redF(), mapPanel.clearColor.greenF(), mapPanel.clearColor.blueF(), 0.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 		fullClearRequested = false;
 	}
 
-	if (videoPanel.clippingEnabled)
+	if (mapPanel.clippingEnabled)
 	{
-		double videoPanelWidth = videoPanel.scale * videoPanel.userScale * videoPanel.textureWidth;
-		double videoPanelHeight = videoPanel.scale * videoPanel.userScale * videoPanel.textureHeight;
-		double leftMargin = (windowWidth - videoPanelWidth) / 2.0;
-		double bottomMargin = (windowHeight - videoPanelHeight) / 2.0;
-
 		glEnable(GL_SCISSOR_TEST);
-
-		glScissor((int)(leftMargin + videoPanel.x + videoPanel.userX + videoPanel.offsetX + 0.5),
-			(int)(bottomMargin + videoPanel.y + videoPanel.userY + videoPanel.offsetY + 0.5),
-			(int)(videoPanelWidth + 0.5),
-			(int)(videoPanelHeight + 0.5));
+		glScissor(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
 	}
 
-	if (videoPanel.clearingEnabled)
+	if (mapPanel.clearingEnabled)
 	{
-		glClearColor(videoPanel.clearColor.redF(), videoPanel.clearColor.greenF(), videoPanel.clearColor.blueF(), 0.0f);
+		glClearColor(mapPanel.clearColor.redF(), mapPanel.clearColor.greenF(), mapPanel.clearColor.blueF(), 0.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 	}
 
-	renderPanel(videoPanel);
+	renderMapTiles();
 	glDisable(GL_SCISSOR_TEST);
 }
 
-void Renderer::renderMapPanel()
+void Renderer::updateMapPanelMatrix()
 {
 	mapPanel.vertexMatrix.setToIdentity();
 
@@ -437,52 +1674,115 @@ void Renderer::renderMapPanel()
 	mapPanel.vertexMatrix.translate(mapPanel.x + mapPanel.userX + routeManager->getX(), mapPanel.y + mapPanel.userY + routeManager->getY()); // map pixel units
 
 	mapPanel.clippingEnabled = (renderMode == RenderMode::All);
+}
 
-	if (fullClearRequested)
+void Renderer::renderMapTiles()
+{
+	// find the visible part of the map by taking the map viewport corners back to map pixels
+	QMatrix4x4 inverseMatrix = mapPanel.vertexMatrix.inverted();
+	float viewportRight = mapPanel.clippingEnabled ? (float)(-1.0 + 2.0 * mapPanel.relativeWidth) : 1.0f;
+	QVector3D corners[4] = { QVector3D(-1.0f, -1.0f, -1.0f), QVector3D(viewportRight, -1.0f, -1.0f), QVector3D(viewportRight, 1.0f, -1.0f), QVector3D(-1.0f, 1.0f, -1.0f) };
+	QPolygonF visiblePolygon;
+
+	for (const QVector3D& corner : corners)
 	{
-		glClearColor(mapPanel.clearColor.redF(), mapPanel.clearColor.greenF(), mapPanel.clearColor.blueF(), 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		fullClearRequested = false;
+		QVector3D position = inverseMatrix.map(corner);
+		visiblePolygon << QPointF(position.x() + mapPanel.textureWidth / 2.0, mapPanel.textureHeight / 2.0 - position.y());
 	}
 
-	if (mapPanel.clippingEnabled)
+	double mapScale = mapPanel.scale * mapPanel.userScale * routeManager->getScale();
+	std::vector<MapTile*> tiles = mapTileManager.getVisibleTiles(visiblePolygon.boundingRect(), mapScale);
+
+	mapPanel.shaderProgram->bind();
+	mapPanel.shaderProgram->setUniformValue("vertexMatrix", mapPanel.vertexMatrix);
+	mapPanel.shaderProgram->setUniformValue("textureSampler", 0);
+
+	if (mapPanel.weightTexture.isCreated())
 	{
-		glEnable(GL_SCISSOR_TEST);
-		glScissor(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
+		mapPanel.shaderProgram->setUniformValue("weightSampler", 1);
+		mapPanel.shaderProgram->setUniformValue("weightCount", (float)weightCount);
+		mapPanel.weightTexture.bind(1, QOpenGLTexture::ResetTextureUnit);
 	}
 
-	if (mapPanel.clearingEnabled)
+	mapPanel.vertexArrayObject.bind();
+	mapPanel.vertexBuffer.bind();
+
+	for (MapTile* tile : tiles)
 	{
-		glClearColor(mapPanel.clearColor.redF(), mapPanel.clearColor.greenF(), mapPanel.clearColor.blueF(), 0.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		float left = (float)(tile->mapRect.left() - mapPanel.textureWidth / 2.0);
+		float right = (float)(tile->mapRect.right() - mapPanel.textureWidth / 2.0);
+		float top = (float)(mapPanel.textureHeight / 2.0 - tile->mapRect.top());
+		float bottom = (float)(mapPanel.textureHeight / 2.0 - tile->mapRect.bottom());
+
+		// 1 2
+		// 4 3
+		GLfloat tileBuffer[] =
+		{
+			left, top, 0.0f, // 1
+			right, top, 0.0f, // 2
+			right, bottom, 0.0f, // 3
+			left, bottom, 0.0f, // 4
+
+			(float)tile->textureRect.left(), (float)tile->textureRect.top(), // 1
+			(float)tile->textureRect.right(), (float)tile->textureRect.top(), // 2
+			(float)tile->textureRect.right(), (float)tile->textureRect.bottom(), // 3
+			(float)tile->textureRect.left(), (float)tile->textureRect.bottom() // 4
+		};
+
+		mapPanel.vertexBuffer.write(0, tileBuffer, sizeof(GLfloat) * 20);
+
+		mapPanel.shaderProgram->setUniformValue("textureWidth", (float)tile->textureWidth);
+		mapPanel.shaderProgram->setUniformValue("textureHeight", (float)tile->textureHeight);
+		mapPanel.shaderProgram->setUniformValue("texelWidth", 1.0f / tile->textureWidth);
+		mapPanel.shaderProgram->setUniformValue("texelHeight", 1.0f / tile->textureHeight);
+		mapPanel.shaderProgram->setUniformValue("maxLod", (float)tile->maxMipLevel);
+
+		tile->texture->bind();
+		glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+		tile->texture->release();
 	}
 
-	renderPanel(mapPanel);
-	glDisable(GL_SCISSOR_TEST);
+	if (mapPanel.weightTexture.isCreated())
+		mapPanel.weightTexture.release(1, QOpenGLTexture::ResetTextureUnit);
+
+	mapPanel.vertexBuffer.release();
+	mapPanel.vertexArrayObject.release();
+	mapPanel.shaderProgram->release();
 }
 
 void Renderer::renderPanel(Panel& panel)
 {
-	panel.shaderProgram.bind();
+	panel.shaderProgram->bind();
+
+	panel.shaderProgram->setUniformValue("vertexMatrix", panel.vertexMatrix);
+	panel.shaderProgram->setUniformValue("textureSampler", 0);
+	panel.shaderProgram->setUniformValue("textureWidth", (float)panel.textureWidth);
+	panel.shaderProgram->setUniformValue("textureHeight", (float)panel.textureHeight);
+	panel.shaderProgram->setUniformValue("texelWidth", (float)panel.texelWidth);
+	panel.shaderProgram->setUniformValue("texelHeight", (float)panel.texelHeight);
+	panel.shaderProgram->setUniformValue("maxLod", 0.0f);
 
-	panel.shaderProgram.setUniformValue("vertexMatrix", panel.vertexMatrix);
-	panel.shaderProgram.setUniformValue("textureSampler", 0);
-	panel.shaderProgram.setUniformValue("textureWidth", (float)panel.textureWidth);
-	panel.shaderProgram.setUniformValue("textureHeight", (float)panel.textureHeight);
-	panel.shaderProgram.setUniformValue("texelWidth", (float)panel.texelWidth);
-	panel.shaderProgram.setUniformValue("texelHeight", (float)panel.texelHeight);
+	if (panel.weightTexture.isCreated())
+	{
+		panel.shaderProgram->setUniformValue("weightSampler", 1);
+		panel.shaderProgram->setUniformValue("weightCount", (float)weightCount);
+		panel.weightTexture.bind(1, QOpenGLTexture::ResetTextureUnit);
+	}
 
 	panel.vertexArrayObject.bind();
 	panel.texture.bind();
 
 	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
 
+	if (panel.weightTexture.isCreated())
+		panel.weightTexture.release(1, QOpenGLTexture::ResetTextureUnit);
+
 	panel.texture.release();
 	panel.vertexArrayObject.release();
-	panel.shaderProgram.release();
+	panel.shaderProgram->release();
 }
 
-void Renderer::renderRoute(Route& route)
+QMatrix Renderer::getRoutePainterMatrix() const
 {
 	QMatrix painterMatrix;
 	painterMatrix.translate(windowWidth / 2.0, windowHeight / 2.0);
@@ -491,49 +1791,160 @@ void Renderer::renderRoute(Route& route)
 	painterMatrix.scale(mapPanel.scale * mapPanel.userScale * routeManager->getScale(), mapPanel.scale * mapPanel.userScale * routeManager->getScale());
 	painterMatrix.translate(mapPanel.x + mapPanel.userX + routeManager->getX(), -(mapPanel.y + mapPanel.userY + routeManager->getY()));
 
-	painter->begin(paintDevice);
-	painter->setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform | QPainter::HighQualityAntialiasing);
+	return painterMatrix;
+}
 
-	if (renderMode != RenderMode::Map)
+void Renderer::renderRoute(Route& route)
+{
+	QMatrix painterMatrix = getRoutePainterMatrix();
+
+	gpuTimer.begin(GpuTimerPass::Route);
+
+	// with the map cache the route line is already part of the cached layer
+	if (route.routeRenderMode != RouteRenderMode::None && !useMapCache)
+		renderRouteVertices(route, painterMatrix);
+
+	// under the overlay, so that the default runner stays on top
+	renderGhostRoutes(painterMatrix);
+
+	if (useOverlayShapes)
+		renderOverlayShapes(route, painterMatrix);
+	else
 	{
-		painter->setClipping(true);
-		painter->setClipRect(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
+		if (overlayFramebuffer != nullptr)
+			beginOverlay();
+
+		painter->begin(paintDevice);
+		paintRouteOverlay(painter, route, painterMatrix);
+		painter->end();
 	}
 
-	painter->setWorldMatrix(painterMatrix);
+	// timer queries can't be nested, so the route ends before the overlay resolve starts
+	gpuTimer.end(GpuTimerPass::Route);
 
-	if (route.routeRenderMode == RouteRenderMode::Discreet || route.routeRenderMode == RouteRenderMode::Highlight)
-	{
-		QPen routePen;
-		routePen.setWidthF(route.routeWidth * route.userScale);
-		routePen.setJoinStyle(Qt::PenJoinStyle::RoundJoin);
-		routePen.setCapStyle(Qt::PenCapStyle::RoundCap);
-		routePen.setColor(route.routeRenderMode == RouteRenderMode::Discreet ? route.discreetColor : route.highlightColor);
+	if (overlayFramebuffer != nullptr)
+		compositeOverlay();
+}
+
+void Renderer::renderCachedMapLayer(Route& route)
+{
+	updateMapPanelMatrix();
 
-		painter->setPen(routePen);
-		painter->setBrush(Qt::NoBrush);
-		painter->drawPath(route.routePath);
+	// a full clear is meant for the frame, renderMapPanel would otherwise spend it on the cache
+	if (fullClearRequested)
+	{
+		glClearColor(mapPanel.clearColor.redF(), mapPanel.clearColor.greenF(), mapPanel.clearColor.blueF(), 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		fullClearRequested = false;
 	}
 
-	if (route.routeRenderMode == RouteRenderMode::Pace)
+	MapLayerState state;
+	state.vertexMatrix = mapPanel.vertexMatrix;
+	state.renderMode = renderMode;
+	state.routeRenderMode = route.routeRenderMode;
+	state.routeWidth = route.routeWidth * route.userScale;
+	state.routeColor = (route.routeRenderMode == RouteRenderMode::Discreet) ? route.discreetColor : route.highlightColor;
+
+	bool stateChanged = (state.vertexMatrix != mapCacheState.vertexMatrix || state.renderMode != mapCacheState.renderMode || state.routeRenderMode != mapCacheState.routeRenderMode || state.routeWidth != mapCacheState.routeWidth || state.routeColor != mapCacheState.routeColor);
+
+	// in fixed split mode the view only moves during the split transitions, the rest of the time this is a single textured quad
+	if (!isMapCacheValid || stateChanged)
 	{
-		QPen paceRoutePen;
-		paceRoutePen.setWidthF(route.routeWidth * route.userScale);
-		paceRoutePen.setCapStyle(Qt::PenCapStyle::RoundCap);
+		mapCacheFramebuffer->bind();
+
+		gpuTimer.begin(GpuTimerPass::MapPanel);
+		renderMapPanel();
+		gpuTimer.end(GpuTimerPass::MapPanel);
 
-		for (int i = 0; i < (int)routeManager->getDefaultRoute().routePoints.size() - 1; ++i)
+		if (route.routeRenderMode != RouteRenderMode::None)
 		{
-			RoutePoint& rp1 = routeManager->getDefaultRoute().routePoints.at(i);
-			RoutePoint& rp2 = routeManager->getDefaultRoute().routePoints.at(i + 1);
+			gpuTimer.begin(GpuTimerPass::Route);
+			renderRouteVertices(route, getRoutePainterMatrix());
+			gpuTimer.end(GpuTimerPass::Route);
+		}
 
-			paceRoutePen.setColor(rp2.color);
+		if (renderToOffscreen)
+			offscreenFramebuffer->bind();
+		else
+			mapCacheFramebuffer->release();
 
-			painter->setPen(paceRoutePen);
-			painter->setBrush(Qt::NoBrush);
-			painter->drawLine(rp1.position, rp2.position);
-		}
+		// tiles that are still loading are drawn from the coarser levels, so keep redrawing until they are all there
+		mapCacheState = state;
+		isMapCacheValid = !mapTileManager.hasMissingTiles();
+	}
+
+	gpuTimer.begin(GpuTimerPass::MapPanel);
+	drawMapLayerTexture(mapCacheFramebuffer);
+	gpuTimer.end(GpuTimerPass::MapPanel);
+}
+
+int Renderer::getMapPanelWidth() const
+{
+	if (renderMode == RenderMode::Map)
+		return (int)windowWidth;
+
+	return std::max(1, std::min((int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowWidth));
+}
+
+void Renderer::beginOverlay()
+{
+	overlayFramebuffer->bind();
+
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+void Renderer::compositeOverlay()
+{
+	// only the map part of the frame can have overlay pixels, so only that part is resolved
+	QRect rect(0, 0, getMapPanelWidth(), windowHeight);
+
+	gpuTimer.begin(GpuTimerPass::Resolve);
+	QOpenGLFramebufferObject::blitFramebuffer(overlayFramebufferNonMultisample, rect, overlayFramebuffer, rect);
+	gpuTimer.end(GpuTimerPass::Resolve);
+
+	offscreenFramebuffer->bind();
+
+	// the paint engine leaves premultiplied colors over the transparent clear
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	drawMapLayerTexture(overlayFramebufferNonMultisample);
+
+	glDisable(GL_BLEND);
+}
+
+void Renderer::drawMapLayerTexture(QOpenGLFramebufferObject* framebuffer)
+{
+	glViewport(0, 0, windowWidth, windowHeight);
+
+	overlayShaderProgram->bind();
+	overlayShaderProgram->setUniformValue("overlaySize", QVector2D(getMapPanelWidth() / windowWidth, 1.0f));
+	overlayShaderProgram->setUniformValue("textureSampler", 0);
+
+	overlayVertexArrayObject.bind();
+	glBindTexture(GL_TEXTURE_2D, framebuffer->texture());
+
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	overlayVertexArrayObject.release();
+	overlayShaderProgram->release();
+}
+
+void Renderer::paintRouteOverlay(QPainter* routePainter, Route& route, const QMatrix& painterMatrix)
+{
+	routePainter->save();
+	routePainter->setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform | QPainter::HighQualityAntialiasing);
+
+	if (renderMode != RenderMode::Map)
+	{
+		routePainter->setClipping(true);
+		routePainter->setClipRect(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
 	}
 
+	routePainter->setWorldMatrix(painterMatrix, true);
+
 	if (route.tailRenderMode == RouteRenderMode::Discreet || route.tailRenderMode == RouteRenderMode::Highlight)
 	{
 		QPen tailPen;
@@ -550,9 +1961,9 @@ void Renderer::renderRoute(Route& route)
 
 		tailPen.setColor(tailColor);
 
-		painter->setPen(tailPen);
-		painter->setBrush(Qt::NoBrush);
-		painter->drawPath(route.tailPath);
+		routePainter->setPen(tailPen);
+		routePainter->setBrush(Qt::NoBrush);
+		routePainter->drawPath(route.tailPath);
 	}
 
 	if (route.showControls)
@@ -563,11 +1974,11 @@ void Renderer::renderRoute(Route& route)
 
 		double controlRadius = route.controlRadius * route.userScale;
 
-		painter->setPen(controlPen);
-		painter->setBrush(Qt::NoBrush);
+		routePainter->setPen(controlPen);
+		routePainter->setBrush(Qt::NoBrush);
 
 		for (const QPointF& controlPosition : routeManager->getDefaultRoute().controlPositions)
-			painter->drawEllipse(controlPosition, controlRadius, controlRadius);
+			routePainter->drawEllipse(controlPosition, controlRadius, controlRadius);
 	}
 
 	if (route.showRunner)
@@ -581,100 +1992,422 @@ void Renderer::renderRoute(Route& route)
 
 		double runnerRadius = route.runnerRadius * route.runnerScale * route.userScale;
 
-		painter->setPen(runnerPen);
-		painter->setBrush(runnerBrush);
-		painter->drawEllipse(routeManager->getDefaultRoute().runnerPosition, runnerRadius, runnerRadius);
+		routePainter->setPen(runnerPen);
+		routePainter->setBrush(runnerBrush);
+		routePainter->drawEllipse(routeManager->getDefaultRoute().runnerPosition, runnerRadius, runnerRadius);
 	}
 
-	painter->setClipping(false);
-	painter->end();
+	routePainter->restore();
 }
 
-void Renderer::renderInfoPanel()
+void Renderer::paintGhostRoutes(QPainter* routePainter, const QMatrix& painterMatrix)
 {
-	QFont font = QFont("DejaVu Sans", infoPanelFontSize, QFont::Bold);
-	QFontMetrics metrics(font);
+	const GhostRouteBatch& ghostRouteBatch = routeManager->getGhostRouteBatch();
 
-	int textX = 10;
-	int textY = 6;
-	int lineHeight = metrics.height();
-	int lineSpacing = metrics.lineSpacing() + 1;
-	int lineWidth1 = metrics.boundingRect("control offset:").width();
-	int lineWidth2 = metrics.boundingRect("99:99:99.999").width();
-	int rightPartMargin = 15;
-	int backgroundRadius = 10;
-	int backgroundWidth = textX + backgroundRadius + lineWidth1 + rightPartMargin + lineWidth2 + 10;
-	int backgroundHeight = lineSpacing * 18 + textY + 3;
+	if (ghostRouteBatch.runnerPositions.empty())
+		return;
 
-	QColor textColor = QColor(255, 255, 255, 200);
-	QColor textGreenColor = QColor(0, 255, 0, 200);
-	QColor textRedColor = QColor(255, 0, 0, 200);
+	Route& defaultRoute = routeManager->getDefaultRoute();
 
-	painter->begin(paintDevice);
-	painter->setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform | QPainter::HighQualityAntialiasing);
+	routePainter->save();
+	routePainter->setRenderHints(QPainter::Antialiasing | QPainter::HighQualityAntialiasing);
 
-	painter->setPen(QColor(0, 0, 0));
-	painter->setBrush(QBrush(QColor(20, 20, 20, 220)));
-	painter->drawRoundedRect(-backgroundRadius, -backgroundRadius, backgroundWidth, backgroundHeight, backgroundRadius, backgroundRadius);
+	if (renderMode != RenderMode::Map)
+	{
+		routePainter->setClipping(true);
+		routePainter->setClipRect(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
+	}
+
+	routePainter->setWorldMatrix(painterMatrix, true);
 
-	painter->setPen(textColor);
-	painter->setFont(font);
+	QPen tailPen;
+	tailPen.setWidthF(defaultRoute.tailWidth * defaultRoute.userScale);
+	tailPen.setJoinStyle(Qt::PenJoinStyle::RoundJoin);
+	tailPen.setCapStyle(Qt::PenCapStyle::RoundCap);
 
-	painter->drawText(textX, textY, lineWidth1, lineHeight, 0, "time:");
+	routePainter->setBrush(Qt::NoBrush);
 
-	textY += lineSpacing;
+	for (size_t i = 0; i < ghostRouteBatch.tailPaths.size(); ++i)
+	{
+		tailPen.setColor(ghostRouteBatch.tailColors.at(i));
+		routePainter->setPen(tailPen);
+		routePainter->drawPath(ghostRouteBatch.tailPaths.at(i));
+	}
 
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "fps:");
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "frame:");
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "decode:");
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "stabilize:");
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "render:");
+	QPen runnerPen;
+	runnerPen.setWidthF(defaultRoute.runnerBorderWidth * defaultRoute.userScale);
+	runnerPen.setColor(defaultRoute.runnerBorderColor);
 
-	if (renderToOffscreen)
-		painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "encode:");
+	double runnerRadius = defaultRoute.runnerRadius * defaultRoute.runnerScale * defaultRoute.userScale;
+
+	routePainter->setPen(runnerPen);
+
+	for (size_t i = 0; i < ghostRouteBatch.runnerPositions.size(); ++i)
+	{
+		routePainter->setBrush(QBrush(ghostRouteBatch.runnerColors.at(i)));
+		routePainter->drawEllipse(ghostRouteBatch.runnerPositions.at(i), runnerRadius, runnerRadius);
+	}
+
+	routePainter->restore();
+}
+
+void Renderer::renderRouteVertices(Route& route, const QMatrix& painterMatrix)
+{
+	if (route.routeVertices.empty())
+		return;
+
+	routeVertexBuffer.bind();
+
+	// the route geometry doesn't depend on the view, so it only needs to be uploaded when the route changes
+	if (routeVertexCount != (int)route.routeVertices.size())
+	{
+		routeVertexCount = (int)route.routeVertices.size();
+		routeVertexBuffer.allocate(route.routeVertices.data(), routeVertexCount * (int)sizeof(RouteVertex));
+	}
+
+	routeVertexBuffer.release();
+
+	// all levels are in the buffer, the one picked for the current zoom is drawn
+	const RouteLevel& routeLevel = route.routeLevels.at(route.routeLevel);
+
+	QColor routeColor = (route.routeRenderMode == RouteRenderMode::Discreet) ? route.discreetColor : route.highlightColor;
+
+	if (renderMode != RenderMode::Map)
+	{
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
+	}
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	routeShaderProgram->bind();
+	routeShaderProgram->setUniformValue("vertexMatrix", getRouteVertexMatrix(painterMatrix));
+	routeShaderProgram->setUniformValue("halfWidth", (float)(route.routeWidth * route.userScale / 2.0));
+	routeShaderProgram->setUniformValue("routeColor", routeColor);
+	routeShaderProgram->setUniformValue("paceAmount", (route.routeRenderMode == RouteRenderMode::Pace) ? 1.0f : 0.0f);
+
+	routeVertexArrayObject.bind();
+	drawRouteShapes([&]() { glDrawArrays(GL_TRIANGLES, routeLevel.firstVertex, routeLevel.vertexCount); });
+	routeVertexArrayObject.release();
+
+	routeShaderProgram->release();
+
+	glDisable(GL_BLEND);
+	glDisable(GL_SCISSOR_TEST);
+}
+
+void Renderer::renderOverlayShapes(Route& route, const QMatrix& painterMatrix)
+{
+	bool showTail = (route.tailRenderMode == RouteRenderMode::Discreet || route.tailRenderMode == RouteRenderMode::Highlight);
+	int tailVertexCount = showTail ? (int)route.tailVertices.size() : 0;
+	int controlVertexCount = route.showControls ? (int)route.controlVertices.size() : 0;
+	int runnerVertexCount = route.showRunner ? (int)route.runnerVertices.size() : 0;
+
+	if (tailVertexCount + controlVertexCount + runnerVertexCount == 0)
+		return;
+
+	// the tail and the runner move every frame, so everything is simply uploaded again
+	overlayShapeVertexBuffer.bind();
+	overlayShapeVertexBuffer.allocate((tailVertexCount + controlVertexCount + runnerVertexCount) * (int)sizeof(RouteVertex));
+	overlayShapeVertexBuffer.write(0, route.tailVertices.data(), tailVertexCount * (int)sizeof(RouteVertex));
+	overlayShapeVertexBuffer.write(tailVertexCount * (int)sizeof(RouteVertex), route.controlVertices.data(), controlVertexCount * (int)sizeof(RouteVertex));
+	overlayShapeVertexBuffer.write((tailVertexCount + controlVertexCount) * (int)sizeof(RouteVertex), route.runnerVertices.data(), runnerVertexCount * (int)sizeof(RouteVertex));
+	overlayShapeVertexBuffer.release();
+
+	if (renderMode != RenderMode::Map)
+	{
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
+	}
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	routeShaderProgram->bind();
+	routeShaderProgram->setUniformValue("vertexMatrix", getRouteVertexMatrix(painterMatrix));
+	routeShaderProgram->setUniformValue("paceAmount", 0.0f);
+
+	overlayShapeVertexArrayObject.bind();
+
+	if (tailVertexCount > 0)
+	{
+		routeShaderProgram->setUniformValue("halfWidth", (float)(route.tailWidth * route.userScale / 2.0));
+		routeShaderProgram->setUniformValue("routeColor", (route.tailRenderMode == RouteRenderMode::Discreet) ? route.discreetColor : route.highlightColor);
+		drawRouteShapes([&]() { glDrawArrays(GL_TRIANGLES, 0, tailVertexCount); });
+	}
+
+	// the painter strokes the control circles centered on the radius, the shader cuts the same ring out of a disc
+	if (controlVertexCount > 0)
+	{
+		double controlRadius = route.controlRadius * route.userScale;
+		double controlBorderWidth = route.controlBorderWidth * route.userScale;
+		double outerRadius = controlRadius + controlBorderWidth / 2.0;
+
+		routeShaderProgram->setUniformValue("halfWidth", (float)outerRadius);
+		routeShaderProgram->setUniformValue("innerRadius", (float)(std::max(0.0, controlRadius - controlBorderWidth / 2.0) / outerRadius));
+		routeShaderProgram->setUniformValue("routeColor", route.controlBorderColor);
+		drawRouteShapes([&]() { glDrawArrays(GL_TRIANGLES, tailVertexCount, controlVertexCount); });
+		routeShaderProgram->setUniformValue("innerRadius", 0.0f);
+	}
+
+	// the border is a larger circle under the runner, like with the ghost runners
+	if (runnerVertexCount > 0)
+	{
+		double runnerRadius = route.runnerRadius * route.runnerScale * route.userScale;
+		double runnerBorderWidth = route.runnerBorderWidth * route.userScale;
+
+		routeShaderProgram->setUniformValue("routeColor", route.runnerBorderColor);
+		routeShaderProgram->setUniformValue("halfWidth", (float)(runnerRadius + runnerBorderWidth / 2.0));
+		drawRouteShapes([&]() { glDrawArrays(GL_TRIANGLES, tailVertexCount + controlVertexCount, runnerVertexCount); });
+
+		routeShaderProgram->setUniformValue("routeColor", route.runnerColor);
+		routeShaderProgram->setUniformValue("halfWidth", (float)std::max(0.0, runnerRadius - runnerBorderWidth / 2.0));
+		drawRouteShapes([&]() { glDrawArrays(GL_TRIANGLES, tailVertexCount + controlVertexCount, runnerVertexCount); });
+	}
+
+	overlayShapeVertexArrayObject.release();
+	routeShaderProgram->release();
+
+	glDisable(GL_BLEND);
+	glDisable(GL_SCISSOR_TEST);
+}
+
+void Renderer::renderGhostRoutes(const QMatrix& painterMatrix)
+{
+	const GhostRouteBatch& ghostRouteBatch = routeManager->getGhostRouteBatch();
+
+	if (ghostRouteBatch.runnerVertices.empty())
+		return;
+
+	const Route& defaultRoute = routeManager->getDefaultRoute();
+
+	// the tails of every ghost route are uploaded once, after that each frame only picks the ranges to draw
+	ghostTailVertexBuffer.bind();
+
+	if (ghostTailVertexCount != (int)ghostRouteBatch.tailVertices.size())
+	{
+		ghostTailVertexCount = (int)ghostRouteBatch.tailVertices.size();
+		ghostTailVertexBuffer.allocate(ghostRouteBatch.tailVertices.data(), ghostTailVertexCount * (int)sizeof(RouteVertex));
+	}
+
+	ghostTailVertexBuffer.release();
+
+	// the tail heads and runners move every frame, they go in one buffer with the heads first
+	int headVertexCount = (int)ghostRouteBatch.tailHeadVertices.size();
+	int runnerVertexCount = (int)ghostRouteBatch.runnerVertices.size();
+
+	ghostFrameVertexBuffer.bind();
+	ghostFrameVertexBuffer.allocate((headVertexCount + runnerVertexCount) * (int)sizeof(RouteVertex));
+	ghostFrameVertexBuffer.write(0, ghostRouteBatch.tailHeadVertices.data(), headVertexCount * (int)sizeof(RouteVertex));
+	ghostFrameVertexBuffer.write(headVertexCount * (int)sizeof(RouteVertex), ghostRouteBatch.runnerVertices.data(), runnerVertexCount * (int)sizeof(RouteVertex));
+	ghostFrameVertexBuffer.release();
+
+	if (renderMode != RenderMode::Map)
+	{
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(0, 0, (int)(mapPanel.relativeWidth * windowWidth + 0.5), (int)windowHeight);
+	}
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	routeShaderProgram->bind();
+	routeShaderProgram->setUniformValue("vertexMatrix", getRouteVertexMatrix(painterMatrix));
+
+	// every tail and runner disc gets its own stencil reference, so overlapping ghosts blend like the painter draws them
+	int ghostCount = (int)ghostRouteBatch.tailVertexCounts.size();
+	int stencilReference = 0;
+
+	auto getNextStencilReference = [&]()
+	{
+		if (stencilReference == 0 || stencilReference == 255)
+		{
+			glClearStencil(0);
+			glClear(GL_STENCIL_BUFFER_BIT);
+			stencilReference = 0;
+		}
+
+		return ++stencilReference;
+	};
+
+	// the colors of the ghost routes are in the vertices
+	routeShaderProgram->setUniformValue("paceAmount", 1.0f);
+	routeShaderProgram->setUniformValue("halfWidth", (float)(defaultRoute.tailWidth * defaultRoute.userScale / 2.0));
+
+	for (int i = 0; i < ghostCount; ++i)
+	{
+		int tailVertexCount = ghostRouteBatch.tailVertexCounts.at(i);
+		int tailHeadVertexCount = ghostRouteBatch.tailHeadVertexCounts.at(i);
+
+		if (tailVertexCount == 0 && tailHeadVertexCount == 0)
+			continue;
+
+		drawRouteShapes([&]()
+		{
+			ghostTailVertexArrayObject.bind();
+			glDrawArrays(GL_TRIANGLES, ghostRouteBatch.tailFirstVertices.at(i), tailVertexCount);
+			ghostTailVertexArrayObject.release();
+
+			ghostFrameVertexArrayObject.bind();
+			glDrawArrays(GL_TRIANGLES, ghostRouteBatch.tailHeadFirstVertices.at(i), tailHeadVertexCount);
+			ghostFrameVertexArrayObject.release();
+		}, getNextStencilReference());
+	}
+
+	// the border is a larger circle under the runner, same as the painter strokes it centered on the edge
+	double runnerRadius = defaultRoute.runnerRadius * defaultRoute.runnerScale * defaultRoute.userScale;
+	double runnerBorderWidth = defaultRoute.runnerBorderWidth * defaultRoute.userScale;
+
+	routeShaderProgram->setUniformValue("routeColor", defaultRoute.runnerBorderColor);
+
+	ghostFrameVertexArrayObject.bind();
+
+	for (int i = 0; i < ghostCount; ++i)
+	{
+		routeShaderProgram->setUniformValue("paceAmount", 0.0f);
+		routeShaderProgram->setUniformValue("halfWidth", (float)(runnerRadius + runnerBorderWidth / 2.0));
+		drawRouteShapes([&]() { glDrawArrays(GL_TRIANGLES, headVertexCount + i * 6, 6); }, getNextStencilReference());
+
+		routeShaderProgram->setUniformValue("paceAmount", 1.0f);
+		routeShaderProgram->setUniformValue("halfWidth", (float)std::max(0.0, runnerRadius - runnerBorderWidth / 2.0));
+		drawRouteShapes([&]() { glDrawArrays(GL_TRIANGLES, headVertexCount + i * 6, 6); }, getNextStencilReference());
+	}
+
+	ghostFrameVertexArrayObject.release();
+	routeShaderProgram->release();
+
+	glDisable(GL_BLEND);
+	glDisable(GL_SCISSOR_TEST);
+}
+
+void Renderer::drawRouteShapes(const std::function<void()>& drawShapes, int stencilReference)
+{
+	// every pixel of the interior is drawn only once, so translucent shapes don't get darker where the pieces overlap
+	// shapes that should still blend with each other are drawn with increasing references into a stencil cleared by the caller
+	if (stencilReference <= 0)
+	{
+		glClearStencil(0);
+		glClear(GL_STENCIL_BUFFER_BIT);
+		stencilReference = 1;
+	}
+
+	glEnable(GL_STENCIL_TEST);
+	glStencilFunc(GL_GREATER, stencilReference, 0xff);
+
+	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+	routeShaderProgram->setUniformValue("edgePass", false);
+	drawShapes();
+
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	routeShaderProgram->setUniformValue("edgePass", true);
+	drawShapes();
+
+	glDisable(GL_STENCIL_TEST);
+}
+
+QMatrix4x4 Renderer::getRouteVertexMatrix(const QMatrix& painterMatrix) const
+{
+	// same transformation as the painter uses, mapped from window pixels to clip space
+	QMatrix4x4 routeMatrix;
+
+	if (!renderToOffscreen)
+		routeMatrix.ortho(0.0f, windowWidth, windowHeight, 0.0f, 0.0f, 1.0f);
 	else
-		painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "spare:");
+		routeMatrix.ortho(0.0f, windowWidth, 0.0f, windowHeight, 0.0f, 1.0f);
 
-	textY += lineSpacing;
+	routeMatrix *= QMatrix4x4(QTransform(painterMatrix));
 
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "scroll:");
+	return routeMatrix;
+}
+
+void Renderer::renderInfoPanel()
+{
+	updateInfoPanel();
+
+	if (infoPanel.updateVertices())
+	{
+		const std::vector<InfoPanelVertex>& vertices = infoPanel.getVertices();
+
+		infoPanelVertexBuffer.bind();
+		infoPanelVertexBuffer.allocate(vertices.data(), (int)(vertices.size() * sizeof(InfoPanelVertex)));
+		infoPanelVertexBuffer.release();
+
+		infoPanelVertexCount = (int)vertices.size();
+	}
+
+	// window pixels with the origin at the top left, the offscreen output is flipped
+	QMatrix4x4 vertexMatrix;
+
+	if (!renderToOffscreen)
+		vertexMatrix.ortho(0.0f, windowWidth, windowHeight, 0.0f, 0.0f, 1.0f);
+	else
+		vertexMatrix.ortho(0.0f, windowWidth, 0.0f, windowHeight, 0.0f, 1.0f);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
-	textY += lineSpacing;
+	infoPanelShaderProgram->bind();
+	infoPanelShaderProgram->setUniformValue("vertexMatrix", vertexMatrix);
+	infoPanelShaderProgram->setUniformValue("textureSampler", 0);
 
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "video scale:");
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "map scale:");
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "route scale:");
+	infoPanelVertexArrayObject.bind();
+	infoPanelTexture->bind();
 
-	textY += lineSpacing;
+	glDrawArrays(GL_TRIANGLES, 0, infoPanelVertexCount);
 
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "control offset:");
-	painter->drawText(textX, textY += lineSpacing, lineWidth1, lineHeight, 0, "runner offset:");
+	infoPanelTexture->release();
+	infoPanelVertexArrayObject.release();
+	infoPanelShaderProgram->release();
+
+	glDisable(GL_BLEND);
+}
 
-	textX += lineWidth1 + rightPartMargin;
-	textY = 6;
+void Renderer::updateInfoPanel()
+{
+	QColor textColor = QColor(255, 255, 255, 200);
+	QColor textGreenColor = QColor(0, 255, 0, 200);
+	QColor textRedColor = QColor(255, 0, 0, 200);
 
 	QTime currentTimeTemp = QTime(0, 0, 0, 0).addMSecs((int)(currentTime * 1000.0 + 0.5));
-	painter->drawText(textX, textY, lineWidth2, lineHeight, 0, currentTimeTemp.toString("HH:mm:ss.zzz"));
+	infoPanel.setValue(0, currentTimeTemp.toString("HH:mm:ss.zzz"), textColor);
 
-	textY += lineSpacing;
+	infoPanel.setValue(2, QString::number(averageFps.getAverage(), 'f', 2), textColor);
+	infoPanel.setValue(3, QString("%1 ms").arg(QString::number(averageFrameDuration.getAverage(), 'f', 2)), textColor);
+	infoPanel.setValue(4, QString("%1 ms").arg(QString::number(averageDecodeDuration.getAverage(), 'f', 2)), textColor);
 
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString::number(averageFps.getAverage(), 'f', 2));
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString("%1 ms").arg(QString::number(averageFrameDuration.getAverage(), 'f', 2)));
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString("%1 ms").arg(QString::number(averageDecodeDuration.getAverage(), 'f', 2)));
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString("%1 ms").arg(QString::number(averageStabilizeDuration.getAverage(), 'f', 2)));
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString("%1 ms").arg(QString::number(averageRenderDuration.getAverage(), 'f', 2)));
+	// in lookahead mode the frames are analyzed on the decoder thread, so that part is shown separately
+	if (averageStabilizeAnalyzeDuration.getAverage() > 0.0)
+		infoPanel.setValue(5, QString("%1 ms + %2 ms").arg(QString::number(averageStabilizeDuration.getAverage(), 'f', 2), QString::number(averageStabilizeAnalyzeDuration.getAverage(), 'f', 2)), textColor);
+	else
+		infoPanel.setValue(5, QString("%1 ms").arg(QString::number(averageStabilizeDuration.getAverage(), 'f', 2)), textColor);
+
+	infoPanel.setValue(6, QString("%1/%2 (%3%)").arg(videoStabilizer->getQualityLevel() + 1).arg(videoStabilizer->getQualityLevelCount()).arg((int)(videoStabilizer->getAnalysisScale() * 100.0 + 0.5)), textColor);
+	infoPanel.setValue(7, QString("%1 ms").arg(QString::number(averageRenderDuration.getAverage(), 'f', 2)), textColor);
 
 	if (renderToOffscreen)
-		painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString("%1 ms").arg(QString::number(averageEncodeDuration.getAverage(), 'f', 2)));
+		infoPanel.setValue(8, QString("%1 ms").arg(QString::number(averageEncodeDuration.getAverage(), 'f', 2)), textColor);
 	else
 	{
+		QColor spareTimeColor = textColor;
+
 		if (averageSpareTime.getAverage() < 0)
-			painter->setPen(textRedColor);
+			spareTimeColor = textRedColor;
 		else if (averageSpareTime.getAverage() > 0)
-			painter->setPen(textGreenColor);
+			spareTimeColor = textGreenColor;
+
+		infoPanel.setValue(8, QString("%1 ms").arg(QString::number(averageSpareTime.getAverage(), 'f', 2)), spareTimeColor);
+	}
+
+	// passes that never ran, like the resolve and readback when rendering to the window, are left out
+	for (int i = 0; i < GpuTimer::passCount; ++i)
+	{
+		GpuTimerPass pass = (GpuTimerPass)i;
 
-		painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString("%1 ms").arg(QString::number(averageSpareTime.getAverage(), 'f', 2)));
-		painter->setPen(textColor);
+		if (gpuTimer.hasMeasurement(pass))
+			infoPanel.setValue(10 + i, QString("%1 ms").arg(QString::number(gpuTimer.getAverageDuration(pass), 'f', 2)), textColor);
+		else
+			infoPanel.setValue(10 + i, "-", textColor);
 	}
 
 	QString scrollText;
@@ -687,22 +2420,14 @@ void Renderer::renderInfoPanel()
 		default: scrollText = "unknown"; break;
 	}
 
-	textY += lineSpacing;
-
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, scrollText);
-
-	textY += lineSpacing;
-
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString::number(videoPanel.userScale, 'f', 2));
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString::number(mapPanel.userScale, 'f', 2));
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString::number(routeManager->getDefaultRoute().userScale, 'f', 2));
-
-	textY += lineSpacing;
+	infoPanel.setValue(17, scrollText, textColor);
 
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString("%1 s").arg(QString::number(routeManager->getDefaultRoute().controlTimeOffset, 'f', 2)));
-	painter->drawText(textX, textY += lineSpacing, lineWidth2, lineHeight, 0, QString("%1 s").arg(QString::number(routeManager->getDefaultRoute().runnerTimeOffset, 'f', 2)));
+	infoPanel.setValue(19, QString::number(videoPanel.userScale, 'f', 2), textColor);
+	infoPanel.setValue(20, QString::number(mapPanel.userScale, 'f', 2), textColor);
+	infoPanel.setValue(21, QString::number(routeManager->getDefaultRoute().userScale, 'f', 2), textColor);
 
-	painter->end();
+	infoPanel.setValue(23, QString("%1 s").arg(QString::number(routeManager->getDefaultRoute().controlTimeOffset, 'f', 2)), textColor);
+	infoPanel.setValue(24, QString("%1 s").arg(QString::number(routeManager->getDefaultRoute().runnerTimeOffset, 'f', 2)), textColor);
 }
 
 Panel& Renderer::getVideoPanel()
@@ -733,4 +2458,5 @@ void Renderer::toggleShowInfoPanel()
 void Renderer::requestFullClear()
 {
 	fullClearRequested = true;
+	isMapCacheValid = false;
 }
@@ -3,6 +3,9 @@
 
 #pragma once
 
+#include <functional>
+#include <vector>
+
 #include <QElapsedTimer>
 #include <QOpenGLFunctions>
 #include <QOpenGLShaderProgram>
@@ -13,8 +16,15 @@
 #include <QOpenGLPaintDevice>
 #include <QPainter>
 
+class QOpenGLFunctions_3_2_Core;
+
 #include "MovingAverage.h"
 #include "FrameData.h"
+#include "MapTileManager.h"
+#include "SoftwareCompositor.h"
+#include "InfoPanel.h"
+#include "GpuTimer.h"
+#include "ShaderCache.h"
 
 namespace OrientView
 {
@@ -32,10 +42,11 @@ namespace OrientView
 	{
 		Panel();
 
-		QOpenGLShaderProgram shaderProgram;
+		QOpenGLShaderProgram* shaderProgram = nullptr;
 		QOpenGLVertexArrayObject vertexArrayObject;
 		QOpenGLBuffer vertexBuffer;
 		QOpenGLTexture texture;
+		QOpenGLTexture weightTexture;
 
 		QMatrix4x4 vertexMatrix;
 
@@ -62,6 +73,36 @@ namespace OrientView
 		double relativeWidth = 1.0;
 	};
 
+	// Everything besides the window size that the cached map and route layer depends on.
+	struct MapLayerState
+	{
+		QMatrix4x4 vertexMatrix;
+		RenderMode renderMode = RenderMode::All;
+		int routeRenderMode = 0;
+		double routeWidth = 0.0;
+		QColor routeColor;
+	};
+
+	// One slot of the rendered frame readback ring.
+	struct ReadbackBuffer
+	{
+		ReadbackBuffer();
+
+		QOpenGLBuffer pixelBuffer;
+		GLsync fence = nullptr;
+		uint8_t* data = nullptr;
+	};
+
+	// One slot of the video frame upload ring.
+	struct UploadBuffer
+	{
+		UploadBuffer();
+
+		QOpenGLBuffer pixelBuffer;
+		GLsync fence = nullptr;
+		uint8_t* mappedData = nullptr;
+	};
+
 	// Does the actual drawing using OpenGL.
 	class Renderer : protected QOpenGLFunctions
 	{
@@ -77,7 +118,12 @@ namespace OrientView
 		void renderAll();
 		void stopRendering();
 
-		FrameData getRenderedFrame();
+		void readRenderedFrame();
+		bool getRenderedFrame(FrameData& frameData);
+		void releaseRenderedFrame();
+		int getPendingReadbackCount() const;
+		int getReadbackBufferCount() const;
+
 		Panel& getVideoPanel();
 		Panel& getMapPanel();
 		RenderMode getRenderMode() const;
@@ -89,17 +135,55 @@ namespace OrientView
 	private:
 
 		bool loadRescaleShader(Panel& panel, const QString& shaderName);
+		bool createWeightTexture(Panel& panel, const QString& filterName, double lanczosSize);
+		bool loadSeparableRescaleShader();
+		QOpenGLShaderProgram* getRescaleProgram(const QString& vertexShaderName, const QString& fragmentShaderName, int tapCount);
+		bool loadRouteShader();
+		bool loadInfoPanelShader();
+		bool loadOverlayShader();
+		void updateVideoPanelMatrix();
+		void updateMapPanelMatrix();
+		QRect getVideoPanelClipRect() const;
+		QMatrix getRoutePainterMatrix() const;
 		void renderVideoPanel();
+		void rescaleVideoRows();
+		void renderRescaledVideoPanel();
 		void renderMapPanel();
+		void renderMapTiles();
 		void renderPanel(Panel& panel);
 		void renderRoute(Route& route);
+		void renderRouteVertices(Route& route, const QMatrix& painterMatrix);
+		void renderOverlayShapes(Route& route, const QMatrix& painterMatrix);
+		void renderGhostRoutes(const QMatrix& painterMatrix);
+		void drawRouteShapes(const std::function<void()>& drawShapes, int stencilReference = 0);
+		QMatrix4x4 getRouteVertexMatrix(const QMatrix& painterMatrix) const;
+		void renderCachedMapLayer(Route& route);
+		void beginOverlay();
+		void compositeOverlay();
+		void drawMapLayerTexture(QOpenGLFramebufferObject* framebuffer);
+		int getMapPanelWidth() const;
 		void renderInfoPanel();
+		void updateInfoPanel();
+		void renderAllInSoftware();
+		void paintPanel(QPainter* panelPainter, Panel& panel, const QImage& image, const QRect& clipRect);
+		std::vector<int> getRouteLevelPointIndices(const Route& route) const;
+		void paintRouteLine(QPainter* routePainter, Route& route, const QMatrix& painterMatrix);
+		void paintRouteOverlay(QPainter* routePainter, Route& route, const QMatrix& painterMatrix);
+		void paintGhostRoutes(QPainter* routePainter, const QMatrix& painterMatrix);
+		bool createUploadBuffers();
+		void deleteUploadBuffers();
+		bool createReadbackBuffers();
+		void deleteReadbackBuffers();
+		bool loadYuvConversionShader();
+		void convertToYuv(QOpenGLFramebufferObject* sourceFbo);
+		int getReadbackDataLength() const;
 
 		VideoStabilizer* videoStabilizer = nullptr;
 		InputHandler* inputHandler = nullptr;
 		RouteManager* routeManager = nullptr;
 
 		bool renderToOffscreen = false;
+		bool renderInSoftware = false;
 		bool showInfoPanel = false;
 		bool fullClearRequested = true;
 
@@ -107,19 +191,29 @@ namespace OrientView
 		double windowHeight = 0.0;
 		double currentTime = 0.0;
 		int multisamples = 0;
+		QString antialiasingMode;
+		int renderAheadFrameCount = 0;
+		int64_t renderAheadMemoryBudget = 0;
 		int infoPanelFontSize = 0;
 
 		Panel videoPanel;
 		Panel mapPanel;
+		MapTileManager mapTileManager;
+		SoftwareCompositor softwareCompositor;
+		QPainterPath softwareRoutePath;
+		int softwareRouteLevel = -1;
 		RenderMode renderMode = RenderMode::All;
 
 		QElapsedTimer renderDurationTimer;
+		ShaderCache shaderCache;
+		GpuTimer gpuTimer;
 		double renderDuration = 0.0;
 
 		MovingAverage averageFps;
 		MovingAverage averageFrameDuration;
 		MovingAverage averageDecodeDuration;
 		MovingAverage averageStabilizeDuration;
+		MovingAverage averageStabilizeAnalyzeDuration;
 		MovingAverage averageRenderDuration;
 		MovingAverage averageEncodeDuration;
 		MovingAverage averageSpareTime;
@@ -129,6 +223,66 @@ namespace OrientView
 
 		QOpenGLFramebufferObject* offscreenFramebuffer = nullptr;
 		QOpenGLFramebufferObject* offscreenFramebufferNonMultisample = nullptr;
-		FrameData renderedFrameData;
+
+		QOpenGLFramebufferObject* overlayFramebuffer = nullptr;
+		QOpenGLFramebufferObject* overlayFramebufferNonMultisample = nullptr;
+		QOpenGLShaderProgram* overlayShaderProgram = nullptr;
+		QOpenGLVertexArrayObject overlayVertexArrayObject;
+		QOpenGLBuffer overlayVertexBuffer;
+
+		bool useMapCache = false;
+		bool isMapCacheValid = false;
+		QOpenGLFramebufferObject* mapCacheFramebuffer = nullptr;
+		MapLayerState mapCacheState;
+
+		QOpenGLShaderProgram* routeShaderProgram = nullptr;
+		QOpenGLVertexArrayObject routeVertexArrayObject;
+		QOpenGLBuffer routeVertexBuffer;
+		int routeVertexCount = 0;
+
+		bool useOverlayShapes = false;
+		QOpenGLVertexArrayObject overlayShapeVertexArrayObject;
+		QOpenGLBuffer overlayShapeVertexBuffer;
+
+		QOpenGLVertexArrayObject ghostTailVertexArrayObject;
+		QOpenGLBuffer ghostTailVertexBuffer;
+		int ghostTailVertexCount = 0;
+		QOpenGLVertexArrayObject ghostFrameVertexArrayObject;
+		QOpenGLBuffer ghostFrameVertexBuffer;
+
+		bool useSeparableRescale = false;
+		QOpenGLFramebufferObject* rescaleFramebuffer = nullptr;
+		QOpenGLVertexArrayObject rescaleVertexArrayObject;
+		QOpenGLBuffer rescaleVertexBuffer;
+		double rescaleFilterScaleX = 1.0;
+		double rescaleFilterScaleY = 1.0;
+
+		InfoPanel infoPanel;
+		QOpenGLShaderProgram* infoPanelShaderProgram = nullptr;
+		QOpenGLVertexArrayObject infoPanelVertexArrayObject;
+		QOpenGLBuffer infoPanelVertexBuffer;
+		QOpenGLTexture* infoPanelTexture = nullptr;
+		int infoPanelVertexCount = 0;
+
+		QOpenGLFramebufferObject* yuvFramebuffer = nullptr;
+		QOpenGLShaderProgram* yuvShaderProgram = nullptr;
+		QOpenGLVertexArrayObject yuvVertexArrayObject;
+		QOpenGLBuffer yuvVertexBuffer;
+		bool useYuvConversion = false;
+		bool isConvertingToYuv = false;
+
+		static const int maxUploadBufferCount = 3;
+		static const int maxReadbackBufferCount = 16;
+
+		QOpenGLFunctions_3_2_Core* coreFunctions = nullptr;
+		UploadBuffer uploadBuffers[maxUploadBufferCount];
+		int uploadBufferCount = 0;
+		int uploadWriteIndex = 0;
+
+		ReadbackBuffer readbackBuffers[maxReadbackBufferCount];
+		int readbackBufferCount = 0;
+		int readbackWriteIndex = 0;
+		int pendingReadbackCount = 0;
+		int mappedReadbackIndex = -1;
 	};
 }
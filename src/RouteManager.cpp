@@ -2,7 +2,9 @@
 // License: GPLv3, see the LICENSE file.
 
 #define _USE_MATH_DEFINES
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include "RouteManager.h"
 #include "QuickRouteReader.h"
@@ -11,6 +13,67 @@
 
 using namespace OrientView;
 
+namespace
+{
+	// the first simplified level, every level after it doubles the tolerance
+	const double firstLevelTolerance = 0.5;
+	const int maxRouteLevelCount = 16;
+
+	RouteVertex createRouteVertex(const QPointF& position, const QColor& color, double offsetX, double offsetY, double u, double v)
+	{
+		RouteVertex vertex;
+
+		vertex.x = (float)position.x();
+		vertex.y = (float)position.y();
+		vertex.offsetX = (float)offsetX;
+		vertex.offsetY = (float)offsetY;
+		vertex.u = (float)u;
+		vertex.v = (float)v;
+		vertex.paceR = (float)color.redF();
+		vertex.paceG = (float)color.greenF();
+		vertex.paceB = (float)color.blueF();
+		vertex.paceA = (float)color.alphaF();
+
+		return vertex;
+	}
+
+	// one rectangle per segment, colors are interpolated along it for smooth pace gradients
+	bool addSegmentVertices(std::vector<RouteVertex>& vertices, const QPointF& position1, const QColor& color1, const QPointF& position2, const QColor& color2)
+	{
+		double dx = position2.x() - position1.x();
+		double dy = position2.y() - position1.y();
+		double length = sqrt(dx * dx + dy * dy);
+
+		if (length < 0.0001)
+			return false;
+
+		double normalX = -dy / length;
+		double normalY = dx / length;
+
+		vertices.push_back(createRouteVertex(position1, color1, normalX, normalY, 0.0, 1.0));
+		vertices.push_back(createRouteVertex(position1, color1, -normalX, -normalY, 0.0, -1.0));
+		vertices.push_back(createRouteVertex(position2, color2, normalX, normalY, 0.0, 1.0));
+
+		vertices.push_back(createRouteVertex(position2, color2, normalX, normalY, 0.0, 1.0));
+		vertices.push_back(createRouteVertex(position1, color1, -normalX, -normalY, 0.0, -1.0));
+		vertices.push_back(createRouteVertex(position2, color2, -normalX, -normalY, 0.0, -1.0));
+
+		return true;
+	}
+
+	// one square per point, the shader cuts it to a circle that fills the joins and caps
+	void addPointVertices(std::vector<RouteVertex>& vertices, const QPointF& position, const QColor& color)
+	{
+		vertices.push_back(createRouteVertex(position, color, -1.0, -1.0, -1.0, -1.0));
+		vertices.push_back(createRouteVertex(position, color, 1.0, -1.0, 1.0, -1.0));
+		vertices.push_back(createRouteVertex(position, color, 1.0, 1.0, 1.0, 1.0));
+
+		vertices.push_back(createRouteVertex(position, color, 1.0, 1.0, 1.0, 1.0));
+		vertices.push_back(createRouteVertex(position, color, -1.0, 1.0, -1.0, 1.0));
+		vertices.push_back(createRouteVertex(position, color, -1.0, -1.0, -1.0, -1.0));
+	}
+}
+
 bool RouteManager::initialize(QuickRouteReader* quickRouteReader, SplitsManager* splitsManager, Renderer* renderer, Settings* settings)
 {
 	this->renderer = renderer;
@@ -57,14 +120,39 @@ bool RouteManager::initialize(QuickRouteReader* quickRouteReader, SplitsManager*
 	defaultRoute.userScale = settings->route.scale;
 	defaultRoute.lowPace = settings->route.lowPace;
 	defaultRoute.highPace = settings->route.highPace;
+	defaultRoute.simplificationTolerance = settings->route.simplificationTolerance;
 
 	for (Route& route : routes)
 	{
 		calculateAlignedRoutePoints(route);
 		calculateRoutePointColors(route);
-		calculateRoutePath(route);
+		calculateSignificances(route.routePoints, route.routePointSignificances);
+		calculateSignificances(route.alignedRoutePoints, route.alignedRoutePointSignificances);
+		calculateRouteVertices(route);
+	}
+
+	ghostRoutes.clear();
+
+	// the ghost routes only need the aligned points, they are drawn as tails and runners in the style of the default route
+	// the settings index keeps the offsets and colors with their files even when some file couldn't be read
+	for (const GhostRoutePoints& ghostRoutePoints : quickRouteReader->getGhostRoutePoints())
+	{
+		Route ghostRoute;
+		int settingsIndex = ghostRoutePoints.settingsIndex;
+
+		ghostRoute.routePoints = ghostRoutePoints.routePoints;
+		ghostRoute.runnerColor = QColor::fromHsvF(fmod(settingsIndex * 0.618034, 1.0), 0.8, 0.95);
+		ghostRoute.tailRenderMode = defaultRoute.tailRenderMode;
+
+		if (settingsIndex < settings->route.ghostRouteTimeOffsets.size())
+			ghostRoute.runnerTimeOffset = settings->route.ghostRouteTimeOffsets.at(settingsIndex).toDouble();
+
+		calculateAlignedRoutePoints(ghostRoute);
+		ghostRoutes.push_back(ghostRoute);
 	}
 
+	calculateGhostTailVertices();
+
 	update(0.0, 0.0);
 
 	if (viewMode == ViewMode::FixedSplit && currentSplitTransformationIndex == -1 && defaultRoute.splitTransformations.size() > 0)
@@ -90,12 +178,18 @@ void RouteManager::update(double currentTime, double frameTime)
 	}
 
 	for (Route& route : routes)
-	{
 		calculateCurrentRunnerPosition(route, currentTime);
+
+	calculateCurrentSplitTransformation(routes.at(0), currentTime, frameTime);
+
+	// the level follows the zoom, so it is picked after the split transformation has been updated
+	for (Route& route : routes)
+	{
+		calculateRouteLevel(route);
 		calculateTailPath(route, currentTime);
 	}
 
-	calculateCurrentSplitTransformation(routes.at(0), currentTime, frameTime);
+	calculateGhostRouteBatch(currentTime);
 }
 
 void RouteManager::calculateAlignedRoutePoints(Route& route)
@@ -172,21 +266,141 @@ void RouteManager::calculateRoutePointColors(Route& route)
 		rp.color = interpolateFromGreenToRed(route.highPace, route.lowPace, rp.pace);
 }
 
-void RouteManager::calculateRoutePath(Route& route)
+void RouteManager::calculateSignificances(const std::vector<RoutePoint>& points, std::vector<double>& significances)
 {
+	significances.assign(points.size(), 0.0);
+
+	if (points.empty())
+		return;
+
+	significances.front() = std::numeric_limits<double>::max();
+	significances.back() = std::numeric_limits<double>::max();
+
+	struct PointRange
+	{
+		int first;
+		int last;
+		double significance;
+	};
+
+	// Douglas-Peucker without a tolerance, every point gets the distance below which it is left out
+	// a point never outlives the point that split its range, so each level is a subset of the previous one
+	std::vector<PointRange> ranges;
+	ranges.push_back({ 0, (int)points.size() - 1, std::numeric_limits<double>::max() });
+
+	while (!ranges.empty())
+	{
+		PointRange range = ranges.back();
+		ranges.pop_back();
+
+		if (range.last - range.first < 2)
+			continue;
+
+		QPointF start = points.at(range.first).position;
+		QPointF end = points.at(range.last).position;
+		double dx = end.x() - start.x();
+		double dy = end.y() - start.y();
+		double lengthSquared = dx * dx + dy * dy;
+
+		int maxIndex = range.first + 1;
+		double maxDistance = -1.0;
+
+		for (int i = range.first + 1; i < range.last; ++i)
+		{
+			QPointF position = points.at(i).position;
+
+			// distance to the segment, not the line, so that a route doubling back on itself is kept
+			double t = 0.0;
+
+			if (lengthSquared > 0.0)
+				t = std::max(0.0, std::min(1.0, ((position.x() - start.x()) * dx + (position.y() - start.y()) * dy) / lengthSquared));
+
+			double distanceX = position.x() - (start.x() + t * dx);
+			double distanceY = position.y() - (start.y() + t * dy);
+			double distance = sqrt(distanceX * distanceX + distanceY * distanceY);
+
+			if (distance > maxDistance)
+			{
+				maxDistance = distance;
+				maxIndex = i;
+			}
+		}
+
+		double significance = std::min(maxDistance, range.significance);
+		significances.at(maxIndex) = significance;
+
+		ranges.push_back({ range.first, maxIndex, significance });
+		ranges.push_back({ maxIndex, range.last, significance });
+	}
+}
+
+void RouteManager::calculateRouteVertices(Route& route)
+{
+	route.routeVertices.clear();
+	route.routeLevels.clear();
+	route.routeLevel = 0;
+
 	if (route.routePoints.size() < 2)
 		return;
 
-	route.routePath = QPainterPath();
+	// the coarser levels add up to about the size of the full one
+	route.routeVertices.reserve(route.routePoints.size() * 24);
 
-	for (size_t i = 0; i < route.routePoints.size(); ++i)
+	std::vector<const RoutePoint*> levelPoints;
+	double tolerance = 0.0;
+
+	for (int level = 0; level < maxRouteLevelCount; ++level)
 	{
-		RoutePoint& rp = route.routePoints.at(i);
+		size_t previousPointCount = levelPoints.size();
+		levelPoints.clear();
 
-		if (i == 0)
-			route.routePath.moveTo(rp.position.x(), rp.position.y());
-		else
-			route.routePath.lineTo(rp.position.x(), rp.position.y());
+		for (size_t i = 0; i < route.routePoints.size(); ++i)
+		{
+			if (route.routePointSignificances.at(i) >= tolerance)
+				levelPoints.push_back(&route.routePoints.at(i));
+		}
+
+		double levelTolerance = tolerance;
+		tolerance = (tolerance == 0.0) ? firstLevelTolerance : tolerance * 2.0;
+
+		// nothing was left out, the same geometry would just be stored twice
+		if (level > 0 && levelPoints.size() == previousPointCount)
+			continue;
+
+		RouteLevel routeLevel;
+		routeLevel.tolerance = levelTolerance;
+		routeLevel.firstVertex = (int)route.routeVertices.size();
+
+		for (size_t i = 0; i < levelPoints.size() - 1; ++i)
+			addSegmentVertices(route.routeVertices, levelPoints.at(i)->position, levelPoints.at(i)->color, levelPoints.at(i + 1)->position, levelPoints.at(i + 1)->color);
+
+		for (const RoutePoint* rp : levelPoints)
+			addPointVertices(route.routeVertices, rp->position, rp->color);
+
+		routeLevel.vertexCount = (int)route.routeVertices.size() - routeLevel.firstVertex;
+		route.routeLevels.push_back(routeLevel);
+
+		if (levelPoints.size() <= 2)
+			break;
+	}
+}
+
+void RouteManager::calculateRouteLevel(Route& route)
+{
+	route.routeLevel = 0;
+
+	// detail finer than the tolerance in window pixels can't be seen, so the drawn vertex count follows the size on screen
+	double mapScale = renderer->getMapPanel().scale * renderer->getMapPanel().userScale * getScale();
+
+	if (mapScale <= 0.0)
+		return;
+
+	double tolerance = route.simplificationTolerance / mapScale;
+
+	for (int i = 0; i < (int)route.routeLevels.size(); ++i)
+	{
+		if (route.routeLevels.at(i).tolerance <= tolerance)
+			route.routeLevel = i;
 	}
 }
 
@@ -204,32 +418,50 @@ void RouteManager::calculateTailPath(Route& route, double currentTime)
 	endIndex = std::max(0, std::min(endIndex, indexMax));
 
 	route.tailPath = QPainterPath();
+	route.tailVertices.clear();
 
 	if (startIndex == endIndex)
 		return;
 
-	RoutePoint startRoutePoint = getInterpolatedRoutePoint(route, startTime);
-	RoutePoint endRoutePoint = getInterpolatedRoutePoint(route, endTime);
+	std::vector<QPointF> tailPositions;
+	tailPositions.push_back(getInterpolatedRoutePoint(route, startTime).position);
 
-	route.tailPath.moveTo(startRoutePoint.position.x(), startRoutePoint.position.y());
+	// same simplification as the route under it
+	double tolerance = route.routeLevels.empty() ? 0.0 : route.routeLevels.at(route.routeLevel).tolerance;
 
 	for (int i = startIndex + 1; i < endIndex; ++i)
 	{
-		RoutePoint& rp = route.alignedRoutePoints.at(i);
-		route.tailPath.lineTo(rp.position.x(), rp.position.y());
+		if (route.alignedRoutePointSignificances.at(i) < tolerance)
+			continue;
+
+		tailPositions.push_back(route.alignedRoutePoints.at(i).position);
 	}
 
-	route.tailPath.lineTo(endRoutePoint.position.x(), endRoutePoint.position.y());
+	tailPositions.push_back(getInterpolatedRoutePoint(route, endTime).position);
+
+	QColor tailColor = (route.tailRenderMode == RouteRenderMode::Discreet) ? route.discreetColor : route.highlightColor;
+
+	route.tailPath.moveTo(tailPositions.front());
+	addPointVertices(route.tailVertices, tailPositions.front(), tailColor);
+
+	for (size_t i = 1; i < tailPositions.size(); ++i)
+	{
+		route.tailPath.lineTo(tailPositions.at(i));
+		addSegmentVertices(route.tailVertices, tailPositions.at(i - 1), tailColor, tailPositions.at(i), tailColor);
+		addPointVertices(route.tailVertices, tailPositions.at(i), tailColor);
+	}
 }
 
 void RouteManager::calculateControlPositions(Route& route)
 {
 	route.controlPositions.clear();
+	route.controlVertices.clear();
 
 	for (const Split& split : route.runnerInfo.splits)
 	{
 		RoutePoint rp = getInterpolatedRoutePoint(route, split.absoluteTime + route.controlTimeOffset);
 		route.controlPositions.push_back(rp.position);
+		addPointVertices(route.controlVertices, rp.position, route.controlBorderColor);
 	}
 }
 
@@ -322,6 +554,9 @@ void RouteManager::calculateCurrentRunnerPosition(Route& route, double currentTi
 {
 	RoutePoint rp = getInterpolatedRoutePoint(route, currentTime + route.runnerTimeOffset);
 	route.runnerPosition = rp.position;
+
+	route.runnerVertices.clear();
+	addPointVertices(route.runnerVertices, route.runnerPosition, route.runnerColor);
 }
 
 void RouteManager::calculateCurrentSplitTransformation(Route& route, double currentTime, double frameTime)
@@ -429,6 +664,104 @@ void RouteManager::calculateCurrentSplitTransformation(Route& route, double curr
 	}
 }
 
+void RouteManager::calculateGhostTailVertices()
+{
+	ghostRouteBatch.tailVertices.clear();
+	ghostRouteBatch.routeFirstVertices.clear();
+
+	// every aligned point has the same number of vertices, so the tail of any time range is a single vertex range
+	for (const Route& route : ghostRoutes)
+	{
+		ghostRouteBatch.routeFirstVertices.push_back((int)ghostRouteBatch.tailVertices.size());
+
+		QColor tailColor = route.runnerColor;
+		tailColor.setAlpha(routes.at(0).highlightColor.alpha());
+
+		for (size_t i = 0; i < route.alignedRoutePoints.size(); ++i)
+		{
+			const QPointF& position = route.alignedRoutePoints.at(i).position;
+			addPointVertices(ghostRouteBatch.tailVertices, position, tailColor);
+
+			if (i + 1 == route.alignedRoutePoints.size())
+				break;
+
+			// a standing runner still needs its six vertices, degenerate triangles don't draw anything
+			if (!addSegmentVertices(ghostRouteBatch.tailVertices, position, tailColor, route.alignedRoutePoints.at(i + 1).position, tailColor))
+				ghostRouteBatch.tailVertices.insert(ghostRouteBatch.tailVertices.end(), 6, createRouteVertex(position, tailColor, 0.0, 0.0, 0.0, 0.0));
+		}
+	}
+}
+
+void RouteManager::calculateGhostRouteBatch(double currentTime)
+{
+	ghostRouteBatch.tailFirstVertices.clear();
+	ghostRouteBatch.tailVertexCounts.clear();
+	ghostRouteBatch.tailHeadFirstVertices.clear();
+	ghostRouteBatch.tailHeadVertexCounts.clear();
+	ghostRouteBatch.tailHeadVertices.clear();
+	ghostRouteBatch.runnerVertices.clear();
+	ghostRouteBatch.tailPaths.clear();
+	ghostRouteBatch.tailColors.clear();
+	ghostRouteBatch.runnerPositions.clear();
+	ghostRouteBatch.runnerColors.clear();
+
+	// the aligned points are one second apart, so the position is found by indexing instead of searching
+	for (size_t i = 0; i < ghostRoutes.size(); ++i)
+	{
+		const Route& route = ghostRoutes.at(i);
+		int pointCount = (int)route.alignedRoutePoints.size();
+
+		if (pointCount < 2)
+			continue;
+
+		// the ghost offsets are relative to the default runner, so the ghosts stay in sync when the user adjusts it
+		double time = std::max(0.0, std::min(currentTime + routes.at(0).runnerTimeOffset + route.runnerTimeOffset, (double)(pointCount - 1)));
+		int index = std::min((int)floor(time), pointCount - 2);
+		double alpha = time - index;
+
+		const QPointF& position1 = route.alignedRoutePoints.at(index).position;
+		const QPointF& position2 = route.alignedRoutePoints.at(index + 1).position;
+		QPointF runnerPosition = (1.0 - alpha) * position1 + alpha * position2;
+
+		addPointVertices(ghostRouteBatch.runnerVertices, runnerPosition, route.runnerColor);
+		ghostRouteBatch.runnerPositions.push_back(runnerPosition);
+		ghostRouteBatch.runnerColors.push_back(route.runnerColor);
+
+		ghostRouteBatch.tailFirstVertices.push_back(0);
+		ghostRouteBatch.tailVertexCounts.push_back(0);
+		ghostRouteBatch.tailHeadFirstVertices.push_back((int)ghostRouteBatch.tailHeadVertices.size());
+		ghostRouteBatch.tailHeadVertexCounts.push_back(0);
+
+		if (route.tailRenderMode == RouteRenderMode::None)
+			continue;
+
+		int startIndex = std::max(0, (int)floor(time - routes.at(0).tailLength));
+
+		if (startIndex < index)
+		{
+			ghostRouteBatch.tailFirstVertices.back() = ghostRouteBatch.routeFirstVertices.at(i) + startIndex * 12;
+			ghostRouteBatch.tailVertexCounts.back() = (index - startIndex) * 12 + 6;
+		}
+
+		QColor tailColor = route.runnerColor;
+		tailColor.setAlpha(routes.at(0).highlightColor.alpha());
+
+		if (addSegmentVertices(ghostRouteBatch.tailHeadVertices, position1, tailColor, runnerPosition, tailColor))
+			ghostRouteBatch.tailHeadVertexCounts.back() = 6;
+
+		QPainterPath tailPath;
+		tailPath.moveTo(route.alignedRoutePoints.at(startIndex).position);
+
+		for (int j = startIndex + 1; j <= index; ++j)
+			tailPath.lineTo(route.alignedRoutePoints.at(j).position);
+
+		tailPath.lineTo(runnerPosition);
+
+		ghostRouteBatch.tailPaths.push_back(tailPath);
+		ghostRouteBatch.tailColors.push_back(tailColor);
+	}
+}
+
 bool RouteManager::findCurrentSplitTransformationIndex(Route& route, double currentTime, int& index)
 {
 	for (int i = 0; i < (int)route.runnerInfo.splits.size() - 1; ++i)
@@ -552,3 +885,8 @@ Route& RouteManager::getDefaultRoute()
 {
 	return routes.at(0);
 }
+
+const GhostRouteBatch& RouteManager::getGhostRouteBatch() const
+{
+	return ghostRouteBatch;
+}
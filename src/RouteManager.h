@@ -30,10 +30,13 @@ namespace OrientView
 		double scale = 1.0;
 	};
 
+	// Route centre line position in map pixels, direction to extrude by the half width, shape coordinate for the distance and pace color.
 	struct RouteVertex
 	{
 		float x = 0.0f;
 		float y = 0.0f;
+		float offsetX = 0.0f;
+		float offsetY = 0.0f;
 		float u = 0.0f;
 		float v = 0.0f;
 		float paceR = 0.0f;
@@ -42,32 +45,48 @@ namespace OrientView
 		float paceA = 1.0f;
 	};
 
+	// One simplification level of the route, its vertices are a range of the route vertices.
+	struct RouteLevel
+	{
+		double tolerance = 0.0; // map pixels
+		int firstVertex = 0;
+		int vertexCount = 0;
+	};
+
 	struct Route
 	{
 		std::vector<RoutePoint> routePoints;
 		std::vector<RoutePoint> alignedRoutePoints;
+		std::vector<double> routePointSignificances;
+		std::vector<double> alignedRoutePointSignificances;
 		std::vector<SplitTransformation> splitTransformations;
 		RunnerInfo runnerInfo;
 
 		QColor discreetColor = QColor(0, 0, 0, 50);
 		QColor highlightColor = QColor(0, 100, 255, 200);
 
-		QPainterPath routePath;
+		std::vector<RouteVertex> routeVertices;
+		std::vector<RouteLevel> routeLevels;
+		int routeLevel = 0;
+		double simplificationTolerance = 0.25; // window pixels
 		RouteRenderMode routeRenderMode = RouteRenderMode::Discreet;
 		double routeWidth = 10.0;
 
 		QPainterPath tailPath;
+		std::vector<RouteVertex> tailVertices; // the same path as route shapes, for frames that aren't multisampled
 		RouteRenderMode tailRenderMode = RouteRenderMode::None;
 		double tailWidth = 10.0;
 		double tailLength = 60.0;
 
 		std::vector<QPointF> controlPositions;
+		std::vector<RouteVertex> controlVertices;
 		QColor controlBorderColor = QColor(140, 40, 140, 255);
 		double controlRadius = 15.0;
 		double controlBorderWidth = 5.0;
 		bool showControls = true;
 
 		QPointF runnerPosition;
+		std::vector<RouteVertex> runnerVertices;
 		QColor runnerColor = QColor(0, 100, 255, 255);
 		QColor runnerBorderColor = QColor(0, 0, 0, 255);
 		double runnerRadius = 10.0;
@@ -82,6 +101,27 @@ namespace OrientView
 		double highPace = 5.0;
 	};
 
+	// Every ghost route in shared vertex arrays, so that only the ranges to draw change between frames.
+	struct GhostRouteBatch
+	{
+		std::vector<RouteVertex> tailVertices; // a join and a segment for each aligned point of every ghost route
+		std::vector<int> routeFirstVertices;
+
+		// updated every frame, the ranges have one entry per runner so that each ghost route can be drawn on its own
+		std::vector<int> tailFirstVertices;
+		std::vector<int> tailVertexCounts;
+		std::vector<int> tailHeadFirstVertices;
+		std::vector<int> tailHeadVertexCounts;
+		std::vector<RouteVertex> tailHeadVertices; // from the last aligned point to the runner
+		std::vector<RouteVertex> runnerVertices;
+
+		// the same frame for the painter, used by the software compositor
+		std::vector<QPainterPath> tailPaths;
+		std::vector<QColor> tailColors;
+		std::vector<QPointF> runnerPositions;
+		std::vector<QColor> runnerColors;
+	};
+
 	class RouteManager
 	{
 
@@ -103,17 +143,22 @@ namespace OrientView
 		void setViewMode(ViewMode value);
 
 		Route& getDefaultRoute();
+		const GhostRouteBatch& getGhostRouteBatch() const;
 
 	private:
 
 		void calculateAlignedRoutePoints(Route& route);
 		void calculateRoutePointColors(Route& route);
-		void calculateRoutePath(Route& route);
+		void calculateSignificances(const std::vector<RoutePoint>& points, std::vector<double>& significances);
+		void calculateRouteVertices(Route& route);
+		void calculateRouteLevel(Route& route);
 		void calculateTailPath(Route& route, double currentTime);
 		void calculateControlPositions(Route& route);
 		void calculateSplitTransformations(Route& route);
 		void calculateCurrentRunnerPosition(Route& route, double currentTime);
 		void calculateCurrentSplitTransformation(Route& route, double currentTime, double frameTime);
+		void calculateGhostTailVertices();
+		void calculateGhostRouteBatch(double currentTime);
 
 		bool findCurrentSplitTransformationIndex(Route& route, double currentTime, int& index);
 		RoutePoint getInterpolatedRoutePoint(Route& route, double time);
@@ -124,6 +169,8 @@ namespace OrientView
 		ViewMode viewMode = ViewMode::FixedSplit;
 
 		std::vector<Route> routes;
+		std::vector<Route> ghostRoutes;
+		GhostRouteBatch ghostRouteBatch;
 
 		bool fullUpdateRequested = true;
 		bool useSmoothSplitTransition = true;
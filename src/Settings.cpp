@@ -24,8 +24,15 @@ void Settings::readFromQSettings(QSettings* settings)
 	map.backgroundColor = settings->value("map/backgroundColor", defaultSettings.map.backgroundColor).value<QColor>();
 	map.headerCrop = settings->value("map/headerCrop", defaultSettings.map.headerCrop).toInt();
 	map.rescaleShader = settings->value("map/rescaleShader", defaultSettings.map.rescaleShader).toString();
+	map.rescaleFilter = settings->value("map/rescaleFilter", defaultSettings.map.rescaleFilter).toString();
+	map.lanczosSize = settings->value("map/lanczosSize", defaultSettings.map.lanczosSize).toDouble();
+	map.tileSize = settings->value("map/tileSize", defaultSettings.map.tileSize).toInt();
+	map.tileCacheSize = settings->value("map/tileCacheSize", defaultSettings.map.tileCacheSize).toInt();
+	map.maxAnisotropy = settings->value("map/maxAnisotropy", defaultSettings.map.maxAnisotropy).toDouble();
 
 	route.quickRouteJpegFilePath = settings->value("route/quickRouteJpegFilePath", defaultSettings.route.quickRouteJpegFilePath).toString();
+	route.ghostRouteFilePaths = settings->value("route/ghostRouteFilePaths", defaultSettings.route.ghostRouteFilePaths).toStringList();
+	route.ghostRouteTimeOffsets = settings->value("route/ghostRouteTimeOffsets", defaultSettings.route.ghostRouteTimeOffsets).toStringList();
 	route.discreetColor = settings->value("route/discreetColor", defaultSettings.route.discreetColor).value<QColor>();
 	route.highlightColor = settings->value("route/highlightColor", defaultSettings.route.highlightColor).value<QColor>();
 	route.routeRenderMode = (RouteRenderMode)settings->value("route/routeRenderMode", defaultSettings.route.routeRenderMode).toInt();
@@ -48,6 +55,7 @@ void Settings::readFromQSettings(QSettings* settings)
 	route.scale = settings->value("route/scale", defaultSettings.route.scale).toDouble();
 	route.lowPace = settings->value("route/lowPace", defaultSettings.route.lowPace).toDouble();
 	route.highPace = settings->value("route/highPace", defaultSettings.route.highPace).toDouble();
+	route.simplificationTolerance = settings->value("route/simplificationTolerance", defaultSettings.route.simplificationTolerance).toDouble();
 	
 	routeManager.viewMode = (ViewMode)settings->value("routeManager/viewMode", defaultSettings.routeManager.viewMode).toInt();
 	routeManager.useSmoothSplitTransition = settings->value("routeManager/useSmoothSplitTransition", defaultSettings.routeManager.useSmoothSplitTransition).toBool();
@@ -66,6 +74,8 @@ void Settings::readFromQSettings(QSettings* settings)
 	video.scale = settings->value("video/scale", defaultSettings.video.scale).toDouble();
 	video.backgroundColor = settings->value("video/backgroundColor", defaultSettings.video.backgroundColor).value<QColor>();
 	video.rescaleShader = settings->value("video/rescaleShader", defaultSettings.video.rescaleShader).toString();
+	video.rescaleFilter = settings->value("video/rescaleFilter", defaultSettings.video.rescaleFilter).toString();
+	video.lanczosSize = settings->value("video/lanczosSize", defaultSettings.video.lanczosSize).toDouble();
 	video.enableClipping = settings->value("video/enableClipping", defaultSettings.video.enableClipping).toBool();
 	video.enableClearing = settings->value("video/enableClearing", defaultSettings.video.enableClearing).toBool();
 	video.frameCountDivisor = settings->value("video/frameCountDivisor", defaultSettings.video.frameCountDivisor).toInt();
@@ -82,10 +92,15 @@ void Settings::readFromQSettings(QSettings* settings)
 	window.multisamples = settings->value("window/multisamples", defaultSettings.window.multisamples).toInt();
 	window.fullscreen = settings->value("window/fullscreen", defaultSettings.window.fullscreen).toBool();
 	window.hideCursor = settings->value("window/hideCursor", defaultSettings.window.hideCursor).toBool();
+	window.swapInterval = settings->value("window/swapInterval", defaultSettings.window.swapInterval).toInt();
 
 	renderer.renderMode = (RenderMode)settings->value("renderer/renderMode", defaultSettings.renderer.renderMode).toInt();
 	renderer.showInfoPanel = settings->value("renderer/showInfoPanel", defaultSettings.renderer.showInfoPanel).toBool();
 	renderer.infoPanelFontSize = settings->value("renderer/infoPanelFontSize", defaultSettings.renderer.infoPanelFontSize).toInt();
+	renderer.useSoftwareRendering = settings->value("renderer/useSoftwareRendering", defaultSettings.renderer.useSoftwareRendering).toBool();
+	renderer.gpuTimingLogFilePath = settings->value("renderer/gpuTimingLogFilePath", defaultSettings.renderer.gpuTimingLogFilePath).toString();
+	renderer.cacheMapLayer = settings->value("renderer/cacheMapLayer", defaultSettings.renderer.cacheMapLayer).toBool();
+	renderer.cacheShaderBinaries = settings->value("renderer/cacheShaderBinaries", defaultSettings.renderer.cacheShaderBinaries).toBool();
 
 	stabilizer.enabled = settings->value("stabilizer/enabled", defaultSettings.stabilizer.enabled).toBool();
 	stabilizer.mode = (VideoStabilizerMode)settings->value("stabilizer/mode", defaultSettings.stabilizer.mode).toInt();
@@ -95,15 +110,30 @@ void Settings::readFromQSettings(QSettings* settings)
 	stabilizer.maxDisplacementFactor = settings->value("stabilizer/maxDisplacementFactor", defaultSettings.stabilizer.maxDisplacementFactor).toDouble();
 	stabilizer.maxAngle = settings->value("stabilizer/maxAngle", defaultSettings.stabilizer.maxAngle).toDouble();
 	stabilizer.frameSizeDivisor = settings->value("stabilizer/frameSizeDivisor", defaultSettings.stabilizer.frameSizeDivisor).toInt();
+	stabilizer.estimator = (VideoStabilizerEstimator)settings->value("stabilizer/estimator", defaultSettings.stabilizer.estimator).toInt();
+	stabilizer.maskRectangles = settings->value("stabilizer/maskRectangles", defaultSettings.stabilizer.maskRectangles).toString();
+	stabilizer.autoMaskDuration = settings->value("stabilizer/autoMaskDuration", defaultSettings.stabilizer.autoMaskDuration).toDouble();
+	stabilizer.autoMaskThreshold = settings->value("stabilizer/autoMaskThreshold", defaultSettings.stabilizer.autoMaskThreshold).toDouble();
+	stabilizer.adaptiveQuality = settings->value("stabilizer/adaptiveQuality", defaultSettings.stabilizer.adaptiveQuality).toBool();
+	stabilizer.adaptiveBudgetFactor = settings->value("stabilizer/adaptiveBudgetFactor", defaultSettings.stabilizer.adaptiveBudgetFactor).toDouble();
+	stabilizer.useCache = settings->value("stabilizer/useCache", defaultSettings.stabilizer.useCache).toBool();
 	stabilizer.passOneOutputFilePath = settings->value("stabilizer/passOneOutputFilePath", defaultSettings.stabilizer.passOneOutputFilePath).toString();
 	stabilizer.passTwoInputFilePath = settings->value("stabilizer/passTwoInputFilePath", defaultSettings.stabilizer.passTwoInputFilePath).toString();
 	stabilizer.passTwoOutputFilePath = settings->value("stabilizer/passTwoOutputFilePath", defaultSettings.stabilizer.passTwoOutputFilePath).toString();
 	stabilizer.smoothingRadius = settings->value("stabilizer/smoothingRadius", defaultSettings.stabilizer.smoothingRadius).toInt();
+	stabilizer.lookaheadFrameCount = settings->value("stabilizer/lookaheadFrameCount", defaultSettings.stabilizer.lookaheadFrameCount).toInt();
+	stabilizer.useTelemetry = settings->value("stabilizer/useTelemetry", defaultSettings.stabilizer.useTelemetry).toBool();
+	stabilizer.telemetryFieldOfView = settings->value("stabilizer/telemetryFieldOfView", defaultSettings.stabilizer.telemetryFieldOfView).toDouble();
+	stabilizer.telemetryAxisOrder = settings->value("stabilizer/telemetryAxisOrder", defaultSettings.stabilizer.telemetryAxisOrder).toString();
 
 	encoder.outputVideoFilePath = settings->value("encoder/outputVideoFilePath", defaultSettings.encoder.outputVideoFilePath).toString();
 	encoder.preset = settings->value("encoder/preset", defaultSettings.encoder.preset).toString();
 	encoder.profile = settings->value("encoder/profile", defaultSettings.encoder.profile).toString();
 	encoder.constantRateFactor = settings->value("encoder/constantRateFactor", defaultSettings.encoder.constantRateFactor).toInt();
+	encoder.useGpuColorConversion = settings->value("encoder/useGpuColorConversion", defaultSettings.encoder.useGpuColorConversion).toBool();
+	encoder.renderAheadFrameCount = settings->value("encoder/renderAheadFrameCount", defaultSettings.encoder.renderAheadFrameCount).toInt();
+	encoder.renderAheadMemoryBudget = settings->value("encoder/renderAheadMemoryBudget", defaultSettings.encoder.renderAheadMemoryBudget).toInt();
+	encoder.antialiasingMode = settings->value("encoder/antialiasingMode", defaultSettings.encoder.antialiasingMode).toString();
 
 	inputHandler.smallSeekAmount = settings->value("inputHandler/smallSeekAmount", defaultSettings.inputHandler.smallSeekAmount).toDouble();
 	inputHandler.normalSeekAmount = settings->value("inputHandler/normalSeekAmount", defaultSettings.inputHandler.normalSeekAmount).toDouble();
@@ -140,8 +170,15 @@ void Settings::writeToQSettings(QSettings* settings)
 	settings->setValue("map/backgroundColor", map.backgroundColor);
 	settings->setValue("map/headerCrop", map.headerCrop);
 	settings->setValue("map/rescaleShader", map.rescaleShader);
+	settings->setValue("map/rescaleFilter", map.rescaleFilter);
+	settings->setValue("map/lanczosSize", map.lanczosSize);
+	settings->setValue("map/tileSize", map.tileSize);
+	settings->setValue("map/tileCacheSize", map.tileCacheSize);
+	settings->setValue("map/maxAnisotropy", map.maxAnisotropy);
 
 	settings->setValue("route/quickRouteJpegFilePath", route.quickRouteJpegFilePath);
+	settings->setValue("route/ghostRouteFilePaths", route.ghostRouteFilePaths);
+	settings->setValue("route/ghostRouteTimeOffsets", route.ghostRouteTimeOffsets);
 	settings->setValue("route/discreetColor", route.discreetColor);
 	settings->setValue("route/highlightColor", route.highlightColor);
 	settings->setValue("route/routeRenderMode", route.routeRenderMode);
@@ -164,6 +201,7 @@ void Settings::writeToQSettings(QSettings* settings)
 	settings->setValue("route/scale", route.scale);
 	settings->setValue("route/lowPace", route.lowPace);
 	settings->setValue("route/highPace", route.highPace);
+	settings->setValue("route/simplificationTolerance", route.simplificationTolerance);
 
 	settings->setValue("routeManager/viewMode", routeManager.viewMode);
 	settings->setValue("routeManager/useSmoothSplitTransition", routeManager.useSmoothSplitTransition);
@@ -182,6 +220,8 @@ void Settings::writeToQSettings(QSettings* settings)
 	settings->setValue("video/scale", video.scale);
 	settings->setValue("video/backgroundColor", video.backgroundColor);
 	settings->setValue("video/rescaleShader", video.rescaleShader);
+	settings->setValue("video/rescaleFilter", video.rescaleFilter);
+	settings->setValue("video/lanczosSize", video.lanczosSize);
 	settings->setValue("video/enableClipping", video.enableClipping);
 	settings->setValue("video/enableClearing", video.enableClearing);
 	settings->setValue("video/frameCountDivisor", video.frameCountDivisor);
@@ -198,10 +238,15 @@ void Settings::writeToQSettings(QSettings* settings)
 	settings->setValue("window/multisamples", window.multisamples);
 	settings->setValue("window/fullscreen", window.fullscreen);
 	settings->setValue("window/hideCursor", window.hideCursor);
+	settings->setValue("window/swapInterval", window.swapInterval);
 	
 	settings->setValue("renderer/renderMode", renderer.renderMode);
 	settings->setValue("renderer/showInfoPanel", renderer.showInfoPanel);
 	settings->setValue("renderer/infoPanelFontSize", renderer.infoPanelFontSize);
+	settings->setValue("renderer/useSoftwareRendering", renderer.useSoftwareRendering);
+	settings->setValue("renderer/gpuTimingLogFilePath", renderer.gpuTimingLogFilePath);
+	settings->setValue("renderer/cacheMapLayer", renderer.cacheMapLayer);
+	settings->setValue("renderer/cacheShaderBinaries", renderer.cacheShaderBinaries);
 
 	settings->setValue("stabilizer/enabled", stabilizer.enabled);
 	settings->setValue("stabilizer/mode", stabilizer.mode);
@@ -211,15 +256,30 @@ void Settings::writeToQSettings(QSettings* settings)
 	settings->setValue("stabilizer/maxDisplacementFactor", stabilizer.maxDisplacementFactor);
 	settings->setValue("stabilizer/maxAngle", stabilizer.maxAngle);
 	settings->setValue("stabilizer/frameSizeDivisor", stabilizer.frameSizeDivisor);
+	settings->setValue("stabilizer/estimator", stabilizer.estimator);
+	settings->setValue("stabilizer/maskRectangles", stabilizer.maskRectangles);
+	settings->setValue("stabilizer/autoMaskDuration", stabilizer.autoMaskDuration);
+	settings->setValue("stabilizer/autoMaskThreshold", stabilizer.autoMaskThreshold);
+	settings->setValue("stabilizer/adaptiveQuality", stabilizer.adaptiveQuality);
+	settings->setValue("stabilizer/adaptiveBudgetFactor", stabilizer.adaptiveBudgetFactor);
+	settings->setValue("stabilizer/useCache", stabilizer.useCache);
 	settings->setValue("stabilizer/passOneOutputFilePath", stabilizer.passOneOutputFilePath);
 	settings->setValue("stabilizer/passTwoInputFilePath", stabilizer.passTwoInputFilePath);
 	settings->setValue("stabilizer/passTwoOutputFilePath", stabilizer.passTwoOutputFilePath);
 	settings->setValue("stabilizer/smoothingRadius", stabilizer.smoothingRadius);
+	settings->setValue("stabilizer/lookaheadFrameCount", stabilizer.lookaheadFrameCount);
+	settings->setValue("stabilizer/useTelemetry", stabilizer.useTelemetry);
+	settings->setValue("stabilizer/telemetryFieldOfView", stabilizer.telemetryFieldOfView);
+	settings->setValue("stabilizer/telemetryAxisOrder", stabilizer.telemetryAxisOrder);
 
 	settings->setValue("encoder/outputVideoFilePath", encoder.outputVideoFilePath);
 	settings->setValue("encoder/preset", encoder.preset);
 	settings->setValue("encoder/profile", encoder.profile);
 	settings->setValue("encoder/constantRateFactor", encoder.constantRateFactor);
+	settings->setValue("encoder/useGpuColorConversion", encoder.useGpuColorConversion);
+	settings->setValue("encoder/renderAheadFrameCount", encoder.renderAheadFrameCount);
+	settings->setValue("encoder/renderAheadMemoryBudget", encoder.renderAheadMemoryBudget);
+	settings->setValue("encoder/antialiasingMode", encoder.antialiasingMode);
 
 	settings->setValue("inputHandler/smallSeekAmount", inputHandler.smallSeekAmount);
 	settings->setValue("inputHandler/normalSeekAmount", inputHandler.normalSeekAmount);
@@ -310,7 +370,11 @@ void Settings::readFromUI(Ui::MainWindow* ui)
 	stabilizer.maxDisplacementFactor = ui->doubleSpinBoxVideoStabilizerMaxDisplacementFactor->value();
 	stabilizer.maxAngle = ui->doubleSpinBoxVideoStabilizerMaxAngle->value();
 	stabilizer.frameSizeDivisor = ui->spinBoxVideoStabilizerFrameSizeDivisor->value();
+	stabilizer.estimator = (VideoStabilizerEstimator)ui->comboBoxVideoStabilizerEstimator->currentIndex();
+	stabilizer.adaptiveQuality = ui->checkBoxVideoStabilizerAdaptiveQuality->isChecked();
+	stabilizer.useCache = ui->checkBoxVideoStabilizerUseCache->isChecked();
 	stabilizer.passOneOutputFilePath = ui->lineEditVideoStabilizerPassOneOutputFile->text();
+	stabilizer.useTelemetry = ui->checkBoxVideoStabilizerUseTelemetry->isChecked();
 	stabilizer.passTwoInputFilePath = ui->lineEditVideoStabilizerPassTwoInputFile->text();
 	stabilizer.passTwoOutputFilePath = ui->lineEditVideoStabilizerPassTwoOutputFile->text();
 	stabilizer.smoothingRadius = ui->spinBoxVideoStabilizerSmoothingRadius->value();
@@ -395,7 +459,11 @@ void Settings::writeToUI(Ui::MainWindow* ui)
 	ui->doubleSpinBoxVideoStabilizerMaxDisplacementFactor->setValue(stabilizer.maxDisplacementFactor);
 	ui->doubleSpinBoxVideoStabilizerMaxAngle->setValue(stabilizer.maxAngle);
 	ui->spinBoxVideoStabilizerFrameSizeDivisor->setValue(stabilizer.frameSizeDivisor);
+	ui->comboBoxVideoStabilizerEstimator->setCurrentIndex(stabilizer.estimator);
+	ui->checkBoxVideoStabilizerAdaptiveQuality->setChecked(stabilizer.adaptiveQuality);
+	ui->checkBoxVideoStabilizerUseCache->setChecked(stabilizer.useCache);
 	ui->lineEditVideoStabilizerPassOneOutputFile->setText(stabilizer.passOneOutputFilePath);
+	ui->checkBoxVideoStabilizerUseTelemetry->setChecked(stabilizer.useTelemetry);
 	ui->lineEditVideoStabilizerPassTwoInputFile->setText(stabilizer.passTwoInputFilePath);
 	ui->lineEditVideoStabilizerPassTwoOutputFile->setText(stabilizer.passTwoOutputFilePath);
 	ui->spinBoxVideoStabilizerSmoothingRadius->setValue(stabilizer.smoothingRadius);
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <QString>
+#include <QStringList>
 #include <QSettings>
 #include <QColor>
 
@@ -41,12 +42,19 @@ namespace OrientView
 			QColor backgroundColor = QColor(255, 255, 255, 255);
 			int headerCrop = 0;
 			QString rescaleShader = "default";
+			QString rescaleFilter = "lanczos";
+			double lanczosSize = 2.0;
+			int tileSize = 512;
+			int tileCacheSize = 256;
+			double maxAnisotropy = 8.0;
 
 		} map;
 
 		struct Route
 		{
 			QString quickRouteJpegFilePath = "";
+			QStringList ghostRouteFilePaths;
+			QStringList ghostRouteTimeOffsets;
 			QColor discreetColor = QColor(0, 0, 0, 80);
 			QColor highlightColor = QColor(0, 100, 255, 200);
 			RouteRenderMode routeRenderMode = RouteRenderMode::Discreet;
@@ -69,6 +77,7 @@ namespace OrientView
 			double scale = 1.0;
 			double lowPace = 15.0;
 			double highPace = 5.0;
+			double simplificationTolerance = 0.25;
 
 		} route;
 
@@ -95,6 +104,8 @@ namespace OrientView
 			double scale = 1.0;
 			QColor backgroundColor = QColor(0, 50, 0, 255);
 			QString rescaleShader = "default";
+			QString rescaleFilter = "lanczos";
+			double lanczosSize = 2.0;
 			bool enableClipping = false;
 			bool enableClearing = true;
 			int frameCountDivisor = 1;
@@ -119,6 +130,7 @@ namespace OrientView
 			int multisamples = 16;
 			bool fullscreen = false;
 			bool hideCursor = false;
+			int swapInterval = 1;
 
 		} window;
 
@@ -127,6 +139,10 @@ namespace OrientView
 			RenderMode renderMode = RenderMode::All;
 			bool showInfoPanel = false;
 			int infoPanelFontSize = 8;
+			bool useSoftwareRendering = false;
+			QString gpuTimingLogFilePath = "";
+			bool cacheMapLayer = true;
+			bool cacheShaderBinaries = true;
 
 		} renderer;
 
@@ -140,10 +156,21 @@ namespace OrientView
 			double maxDisplacementFactor = 0.5;
 			double maxAngle = 15.0;
 			int frameSizeDivisor = 8;
+			VideoStabilizerEstimator estimator = VideoStabilizerEstimator::FeatureTracking;
+			QString maskRectangles = "";
+			double autoMaskDuration = 0.0;
+			double autoMaskThreshold = 2.0;
+			bool adaptiveQuality = false;
+			double adaptiveBudgetFactor = 0.5;
+			bool useCache = true;
 			QString passOneOutputFilePath = "";
 			QString passTwoInputFilePath = "";
 			QString passTwoOutputFilePath = "";
 			int smoothingRadius = 15;
+			int lookaheadFrameCount = 15;
+			bool useTelemetry = false;
+			double telemetryFieldOfView = 120.0;
+			QString telemetryAxisOrder = "";
 
 		} stabilizer;
 
@@ -153,6 +180,10 @@ namespace OrientView
 			QString preset = "veryfast";
 			QString profile = "high";
 			int constantRateFactor = 23;
+			bool useGpuColorConversion = true;
+			int renderAheadFrameCount = 4;
+			int renderAheadMemoryBudget = 256;
+			QString antialiasingMode = "multisample";
 
 		} encoder;
 
@@ -0,0 +1,234 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "ShaderCache.h"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+using namespace OrientView;
+
+namespace
+{
+	// bump when the binary file layout or the attribute locations change
+	const int cacheVersion = 1;
+
+	// every program gets the same locations, so a vertex array object works with any program that has the same inputs
+	const char* attributeNames[] = { "vertexPosition", "vertexTextureCoordinate", "vertexOffset", "vertexShapeCoordinate", "vertexColor" };
+}
+
+bool ShaderCache::initialize(bool useBinaryCache)
+{
+	initializeOpenGLFunctions();
+
+	isBinaryCacheAvailable = false;
+
+	QOpenGLContext* context = QOpenGLContext::currentContext();
+
+	driverName = QByteArray((const char*)glGetString(GL_VENDOR)) + ";" + (const char*)glGetString(GL_RENDERER) + ";" + (const char*)glGetString(GL_VERSION);
+
+	if (!useBinaryCache)
+		return true;
+
+	if (context->format().version() < qMakePair(4, 1) && !context->hasExtension("GL_ARB_get_program_binary"))
+	{
+		qWarning("OpenGL program binaries are not available, compiling shaders at every startup");
+		return true;
+	}
+
+	getProgramBinary = (GetProgramBinaryFunction)context->getProcAddress("glGetProgramBinary");
+	programBinary = (ProgramBinaryFunction)context->getProcAddress("glProgramBinary");
+	programParameteri = (ProgramParameteriFunction)context->getProcAddress("glProgramParameteri");
+
+	GLint binaryFormatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+
+	// some drivers expose the functions without supporting a single format
+	if (getProgramBinary == nullptr || programBinary == nullptr || programParameteri == nullptr || binaryFormatCount <= 0)
+	{
+		qWarning("OpenGL program binaries are not supported by the driver, compiling shaders at every startup");
+		return true;
+	}
+
+	QString cacheLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+	if (cacheLocation.isEmpty() || !QDir().mkpath(cacheLocation + "/shaders"))
+	{
+		qWarning("Could not create shader cache directory");
+		return true;
+	}
+
+	cacheDirectory = cacheLocation + "/shaders";
+	isBinaryCacheAvailable = true;
+
+	return true;
+}
+
+ShaderCache::~ShaderCache()
+{
+	for (auto& it : programs)
+		delete it.second;
+
+	programs.clear();
+}
+
+QOpenGLShaderProgram* ShaderCache::getProgram(const QString& vertexShaderName, const QString& fragmentShaderName, const QByteArray& defines)
+{
+	QString programName = QString("%1;%2;%3").arg(vertexShaderName, fragmentShaderName, QString(defines));
+	auto it = programs.find(programName);
+
+	if (it != programs.end())
+		return it->second;
+
+	QByteArray vertexShaderSource;
+	QByteArray fragmentShaderSource;
+
+	if (!readShaderSource(vertexShaderName + ".vert", defines, vertexShaderSource) || !readShaderSource(fragmentShaderName + ".frag", defines, fragmentShaderSource))
+		return nullptr;
+
+	QOpenGLShaderProgram* program = new QOpenGLShaderProgram();
+
+	for (int i = 0; i < (int)(sizeof(attributeNames) / sizeof(attributeNames[0])); ++i)
+		program->bindAttributeLocation(attributeNames[i], i);
+
+	// a driver update changes the name, so old binaries are never loaded into a new driver
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(QByteArray::number(cacheVersion));
+	hash.addData(driverName);
+	hash.addData(vertexShaderSource);
+	hash.addData(fragmentShaderSource);
+
+	QString binaryFilePath = QString("%1/%2.bin").arg(cacheDirectory, QString(hash.result().toHex()));
+
+	if (isBinaryCacheAvailable && loadProgramBinary(program, binaryFilePath))
+	{
+		qDebug("Loaded shader %s from the cache", qPrintable(programName));
+		programs[programName] = program;
+		return program;
+	}
+
+	if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShaderSource) || !program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShaderSource))
+	{
+		qWarning("Could not compile shader %s", qPrintable(programName));
+		delete program;
+		return nullptr;
+	}
+
+	// the hint has to be set before linking, otherwise the driver may not keep the binary around
+	if (isBinaryCacheAvailable)
+		programParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+	if (!program->link())
+	{
+		qWarning("Could not link shader %s", qPrintable(programName));
+		delete program;
+		return nullptr;
+	}
+
+	qDebug("Compiled shader %s", qPrintable(programName));
+
+	if (isBinaryCacheAvailable)
+		storeProgramBinary(program, binaryFilePath);
+
+	programs[programName] = program;
+	return program;
+}
+
+bool ShaderCache::readShaderSource(const QString& fileName, const QByteArray& defines, QByteArray& source)
+{
+	QFile shaderFile(QString(":/shaders/%1").arg(fileName));
+
+	if (!shaderFile.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		qWarning("Could not read shader %s", qPrintable(fileName));
+		return false;
+	}
+
+	source = shaderFile.readAll();
+
+	// the defines have to come after the version line
+	if (!defines.isEmpty())
+		source.insert(source.indexOf('\n') + 1, defines);
+
+	return true;
+}
+
+bool ShaderCache::loadProgramBinary(QOpenGLShaderProgram* program, const QString& binaryFilePath)
+{
+	QFile binaryFile(binaryFilePath);
+
+	if (!binaryFile.open(QIODevice::ReadOnly))
+		return false;
+
+	QByteArray binaryData = binaryFile.readAll();
+	binaryFile.close();
+
+	if (binaryData.size() <= (int)sizeof(GLenum))
+		return false;
+
+	GLenum binaryFormat = 0;
+	memcpy(&binaryFormat, binaryData.constData(), sizeof(GLenum));
+
+	if (!program->create())
+		return false;
+
+	programBinary(program->programId(), binaryFormat, binaryData.constData() + sizeof(GLenum), binaryData.size() - (int)sizeof(GLenum));
+
+	// the driver can reject a binary at any time, then it is compiled again and the file replaced
+	GLint linkStatus = 0;
+	glGetProgramiv(program->programId(), GL_LINK_STATUS, &linkStatus);
+
+	if (linkStatus == 0)
+	{
+		qWarning("Shader cache file was rejected by the driver, compiling the shader again");
+		return false;
+	}
+
+	// without any shaders added, link only picks up the status of the loaded binary
+	return program->link();
+}
+
+void ShaderCache::storeProgramBinary(QOpenGLShaderProgram* program, const QString& binaryFilePath)
+{
+	GLint binaryLength = 0;
+	glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+
+	if (binaryLength <= 0)
+		return;
+
+	QByteArray binaryData(binaryLength, 0);
+	GLsizei writtenLength = 0;
+	GLenum binaryFormat = 0;
+
+	getProgramBinary(program->programId(), binaryLength, &writtenLength, &binaryFormat, binaryData.data());
+
+	if (writtenLength <= 0)
+		return;
+
+	binaryData.resize(writtenLength);
+	binaryData.prepend(QByteArray((const char*)&binaryFormat, sizeof(GLenum)));
+
+	// written to a temporary file first, so that a preview and an encode starting at the same time never see half a file
+	QSaveFile binaryFile(binaryFilePath);
+
+	if (!binaryFile.open(QIODevice::WriteOnly) || binaryFile.write(binaryData) != binaryData.size() || !binaryFile.commit())
+		qWarning("Could not write shader cache file");
+}
@@ -0,0 +1,46 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#pragma once
+
+#include <map>
+
+#include <QByteArray>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QString>
+
+namespace OrientView
+{
+	// Compile shader programs from the embedded sources once, share them and keep their linked binaries on disk between runs.
+	class ShaderCache : protected QOpenGLFunctions
+	{
+
+	public:
+
+		bool initialize(bool useBinaryCache);
+		~ShaderCache();
+
+		QOpenGLShaderProgram* getProgram(const QString& vertexShaderName, const QString& fragmentShaderName, const QByteArray& defines = QByteArray());
+
+	private:
+
+		typedef void (QOPENGLF_APIENTRYP GetProgramBinaryFunction)(GLuint program, GLsizei bufferSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+		typedef void (QOPENGLF_APIENTRYP ProgramBinaryFunction)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+		typedef void (QOPENGLF_APIENTRYP ProgramParameteriFunction)(GLuint program, GLenum name, GLint value);
+
+		bool readShaderSource(const QString& fileName, const QByteArray& defines, QByteArray& source);
+		bool loadProgramBinary(QOpenGLShaderProgram* program, const QString& binaryFilePath);
+		void storeProgramBinary(QOpenGLShaderProgram* program, const QString& binaryFilePath);
+
+		std::map<QString, QOpenGLShaderProgram*> programs;
+
+		bool isBinaryCacheAvailable = false;
+		QString cacheDirectory;
+		QByteArray driverName;
+
+		GetProgramBinaryFunction getProgramBinary = nullptr;
+		ProgramBinaryFunction programBinary = nullptr;
+		ProgramParameteriFunction programParameteri = nullptr;
+	};
+}
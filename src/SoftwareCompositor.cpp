@@ -0,0 +1,232 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <QPainter>
+#include <QRunnable>
+#include <QThread>
+#include <QtEndian>
+
+#include "SoftwareCompositor.h"
+
+using namespace OrientView;
+
+namespace
+{
+	// the coarsest map level, below this the bilinear filter alone is enough
+	const int minimumMapLevelSize = 256;
+
+	uint32_t swapRedAndBlue(uint32_t pixel)
+	{
+		return ((pixel & 0x00ff0000) >> 16) | ((pixel & 0x000000ff) << 16) | (pixel & 0xff00ff00);
+	}
+
+	// QPainter works with 0xAARRGGBB words, the video frames are R, G, B, A bytes
+	// the loops have no dependencies between pixels, so the compiler turns them into SIMD swizzles
+	void convertRgbaToArgb(const uint8_t* source, QRgb* destination, int count)
+	{
+		for (int i = 0; i < count; ++i)
+			destination[i] = swapRedAndBlue(qFromLittleEndian<quint32>(source + i * 4)) | 0xff000000;
+	}
+
+	void convertArgbToRgba(const QRgb* source, uint8_t* destination, int count)
+	{
+		for (int i = 0; i < count; ++i)
+			qToLittleEndian<quint32>(swapRedAndBlue(source[i]), destination + i * 4);
+	}
+
+	class BandRenderer : public QRunnable
+	{
+
+	public:
+
+		BandRenderer(SoftwareCompositor* softwareCompositor, int bandIndex, bool isCompositing) : softwareCompositor(softwareCompositor), bandIndex(bandIndex), isCompositing(isCompositing) {}
+
+		void run()
+		{
+			if (isCompositing)
+				softwareCompositor->compositeBand(bandIndex);
+			else
+				softwareCompositor->renderBand(bandIndex);
+		}
+
+	private:
+
+		SoftwareCompositor* softwareCompositor;
+		int bandIndex;
+		bool isCompositing;
+	};
+
+	class OverlayRenderer : public QRunnable
+	{
+
+	public:
+
+		OverlayRenderer(SoftwareCompositor* softwareCompositor) : softwareCompositor(softwareCompositor) {}
+		void run() { softwareCompositor->renderOverlay(); }
+
+	private:
+
+		SoftwareCompositor* softwareCompositor;
+	};
+}
+
+bool SoftwareCompositor::initialize(const QImage& mapImage)
+{
+	qDebug("Initializing software compositor");
+
+	// the raster engine has its fastest transformed and filtered paths for premultiplied ARGB
+	mapImages.clear();
+	mapImages.push_back(mapImage.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+
+	if (mapImages.back().isNull())
+	{
+		qWarning("Could not convert map image");
+		return false;
+	}
+
+	// same pyramid as the GPU tiles, so that minification looks the same on both paths
+	while (mapImages.back().width() > minimumMapLevelSize && mapImages.back().height() > minimumMapLevelSize)
+	{
+		QSize levelSize(std::max(1, mapImages.back().width() / 2), std::max(1, mapImages.back().height() / 2));
+		mapImages.push_back(mapImages.back().scaled(levelSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+	}
+
+	threadPool.setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+	bandCount = threadPool.maxThreadCount();
+
+	return true;
+}
+
+void SoftwareCompositor::resize(int width, int height)
+{
+	image = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::black);
+
+	overlayImage = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+	overlayImage.fill(Qt::transparent);
+
+	outputImage = QImage(width, height, QImage::Format_RGBA8888_Premultiplied);
+	outputImage.fill(Qt::black);
+}
+
+SoftwareCompositor::~SoftwareCompositor()
+{
+	threadPool.waitForDone();
+}
+
+void SoftwareCompositor::setVideoFrame(const FrameData& frameData)
+{
+	if (frameData.data == nullptr || frameData.width <= 0 || frameData.height <= 0)
+		return;
+
+	if (videoImage.width() != frameData.width || videoImage.height() != frameData.height)
+		videoImage = QImage(frameData.width, frameData.height, QImage::Format_RGB32);
+
+	// the decoder reuses its buffer as soon as the frame is signaled read, so the pixels are copied here
+	for (int y = 0; y < frameData.height; ++y)
+		convertRgbaToArgb(frameData.data + y * frameData.rowLength, (QRgb*)videoImage.scanLine(y), frameData.width);
+}
+
+void SoftwareCompositor::render(const std::function<void(QPainter* painter)>& paintPanels, const std::function<void(QPainter* painter)>& paintOverlay)
+{
+	paintPanelsFunction = paintPanels;
+	paintOverlayFunction = paintOverlay;
+
+	// taken once here, the non-const accessors would try to detach the images from the worker threads
+	imageBits = image.bits();
+	overlayImageBits = overlayImage.bits();
+	outputImageBits = outputImage.bits();
+
+	// the vector paths are stroked only once and by a single thread, while the panel images are split between the rest
+	threadPool.start(new OverlayRenderer(this));
+
+	for (int i = 0; i < bandCount; ++i)
+		threadPool.start(new BandRenderer(this, i, false));
+
+	threadPool.waitForDone();
+
+	for (int i = 0; i < bandCount; ++i)
+		threadPool.start(new BandRenderer(this, i, true));
+
+	threadPool.waitForDone();
+
+	paintPanelsFunction = nullptr;
+	paintOverlayFunction = nullptr;
+}
+
+void SoftwareCompositor::renderBand(int bandIndex)
+{
+	int bandHeight = (image.height() + bandCount - 1) / bandCount;
+	int bandTop = bandIndex * bandHeight;
+
+	bandHeight = std::min(bandHeight, image.height() - bandTop);
+
+	if (bandHeight <= 0)
+		return;
+
+	// every band paints all the panels, the band image clips them to its own rows
+	QImage bandImage(imageBits + bandTop * image.bytesPerLine(), image.width(), bandHeight, image.bytesPerLine(), image.format());
+
+	QPainter painter(&bandImage);
+	painter.translate(0.0, -bandTop);
+	paintPanelsFunction(&painter);
+}
+
+void SoftwareCompositor::renderOverlay()
+{
+	QImage targetImage(overlayImageBits, overlayImage.width(), overlayImage.height(), overlayImage.bytesPerLine(), overlayImage.format());
+	targetImage.fill(Qt::transparent);
+
+	QPainter painter(&targetImage);
+	paintOverlayFunction(&painter);
+}
+
+void SoftwareCompositor::compositeBand(int bandIndex)
+{
+	int bandHeight = (image.height() + bandCount - 1) / bandCount;
+	int bandTop = bandIndex * bandHeight;
+
+	bandHeight = std::min(bandHeight, image.height() - bandTop);
+
+	if (bandHeight <= 0)
+		return;
+
+	QImage bandImage(imageBits + bandTop * image.bytesPerLine(), image.width(), bandHeight, image.bytesPerLine(), image.format());
+	QImage overlayBandImage((const uchar*)(overlayImageBits + bandTop * overlayImage.bytesPerLine()), overlayImage.width(), bandHeight, overlayImage.bytesPerLine(), overlayImage.format());
+
+	QPainter painter(&bandImage);
+	painter.drawImage(0, 0, overlayBandImage);
+	painter.end();
+
+	for (int y = bandTop; y < bandTop + bandHeight; ++y)
+		convertArgbToRgba((const QRgb*)(imageBits + y * image.bytesPerLine()), outputImageBits + y * outputImage.bytesPerLine(), image.width());
+}
+
+QImage& SoftwareCompositor::getImage()
+{
+	return image;
+}
+
+const QImage& SoftwareCompositor::getOutputImage() const
+{
+	return outputImage;
+}
+
+const QImage& SoftwareCompositor::getVideoImage() const
+{
+	return videoImage;
+}
+
+const QImage& SoftwareCompositor::getMapImage(double scale) const
+{
+	int level = 0;
+
+	if (scale > 0.0)
+		level = std::max(0, std::min((int)floor(log2(1.0 / scale)), (int)mapImages.size() - 1));
+
+	return mapImages.at(level);
+}
@@ -0,0 +1,56 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <QImage>
+#include <QThreadPool>
+
+#include "FrameData.h"
+
+class QPainter;
+
+namespace OrientView
+{
+	// Composite frames on the CPU, the panels in horizontal bands painted in parallel and the vector overlay once on top of them.
+	class SoftwareCompositor
+	{
+
+	public:
+
+		bool initialize(const QImage& mapImage);
+		void resize(int width, int height);
+		~SoftwareCompositor();
+
+		void setVideoFrame(const FrameData& frameData);
+		void render(const std::function<void(QPainter* painter)>& paintPanels, const std::function<void(QPainter* painter)>& paintOverlay);
+		void renderBand(int bandIndex);
+		void renderOverlay();
+		void compositeBand(int bandIndex);
+
+		QImage& getImage();
+		const QImage& getOutputImage() const;
+		const QImage& getVideoImage() const;
+		const QImage& getMapImage(double scale) const;
+
+	private:
+
+		QThreadPool threadPool;
+		int bandCount = 1;
+
+		QImage image;
+		QImage overlayImage;
+		QImage outputImage;
+		uchar* imageBits = nullptr;
+		uchar* overlayImageBits = nullptr;
+		uchar* outputImageBits = nullptr;
+		QImage videoImage;
+		std::vector<QImage> mapImages;
+
+		std::function<void(QPainter* painter)> paintPanelsFunction;
+		std::function<void(QPainter* painter)> paintOverlayFunction;
+	};
+}
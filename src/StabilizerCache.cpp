@@ -0,0 +1,323 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#include <cstdio>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+}
+
+#include "StabilizerCache.h"
+#include "Settings.h"
+
+using namespace OrientView;
+
+namespace
+{
+	// bump when the analysis changes in a way that makes old results invalid
+	const int cacheVersion = 1;
+
+	const int sampledPacketCount = 16;
+
+	const char* passOneHeader = "timeStamp;cumulativeX;cumulativeY;cumulativeAngle\n";
+}
+
+bool StabilizerCache::initialize(Settings* settings)
+{
+	fingerprint.clear();
+	cacheFilePath.clear();
+
+	if (!calculateFingerprint(settings))
+		return false;
+
+	QString cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+	if (cacheDirectory.isEmpty())
+	{
+		qWarning("Could not find a cache directory");
+		return false;
+	}
+
+	cacheFilePath = QString("%1/stabilizer/%2.csv").arg(cacheDirectory, fingerprint);
+
+	return true;
+}
+
+bool StabilizerCache::calculateFingerprint(Settings* settings)
+{
+	QFileInfo videoFileInfo(settings->video.inputVideoFilePath);
+
+	if (!videoFileInfo.exists())
+	{
+		qWarning("Could not find input video file");
+		return false;
+	}
+
+	av_register_all();
+
+	AVFormatContext* formatContext = nullptr;
+
+	if (avformat_open_input(&formatContext, settings->video.inputVideoFilePath.toUtf8().constData(), nullptr, nullptr) < 0)
+	{
+		qWarning("Could not open source file");
+		return false;
+	}
+
+	if (avformat_find_stream_info(formatContext, nullptr) < 0)
+	{
+		qWarning("Could not find stream information");
+		avformat_close_input(&formatContext);
+		return false;
+	}
+
+	int videoStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+
+	if (videoStreamIndex < 0)
+	{
+		qWarning("Could not find video stream in input file");
+		avformat_close_input(&formatContext);
+		return false;
+	}
+
+	AVStream* videoStream = formatContext->streams[videoStreamIndex];
+	videoStartTime = (videoStream->start_time != AV_NOPTS_VALUE) ? videoStream->start_time : 0;
+	videoDuration = (videoStream->duration != AV_NOPTS_VALUE) ? videoStream->duration : 0;
+
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+
+	hash.addData(QString("version=%1;size=%2;duration=%3;startTime=%4;frames=%5;")
+		.arg(cacheVersion)
+		.arg((qlonglong)videoFileInfo.size())
+		.arg((qlonglong)videoDuration)
+		.arg((qlonglong)videoStartTime)
+		.arg((qlonglong)videoStream->nb_frames).toUtf8());
+
+	hash.addData(QString("width=%1;height=%2;codec=%3;timeBase=%4/%5;")
+		.arg(videoStream->codec->width)
+		.arg(videoStream->codec->height)
+		.arg((int)videoStream->codec->codec_id)
+		.arg(videoStream->time_base.num)
+		.arg(videoStream->time_base.den).toUtf8());
+
+	// size and duration alone can't tell apart two recordings of the same length, so hash packets spread over the whole file
+	AVPacket packet;
+	av_init_packet(&packet);
+	packet.data = nullptr;
+	packet.size = 0;
+
+	for (int i = 0; i < sampledPacketCount; ++i)
+	{
+		int64_t targetTimeStamp = videoStartTime + (videoDuration * i) / sampledPacketCount;
+
+		if (av_seek_frame(formatContext, videoStreamIndex, targetTimeStamp, AVSEEK_FLAG_BACKWARD) < 0)
+			qWarning("Could not seek video to sample packets, continuing from the current position");
+
+		while (av_read_frame(formatContext, &packet) >= 0)
+		{
+			bool isVideoPacket = (packet.stream_index == videoStreamIndex);
+
+			if (isVideoPacket)
+			{
+				hash.addData((const char*)packet.data, packet.size);
+				hash.addData(QByteArray::number((qlonglong)packet.pts));
+			}
+
+			av_free_packet(&packet);
+
+			if (isVideoPacket)
+				break;
+		}
+	}
+
+	avformat_close_input(&formatContext);
+
+	// everything that changes the pass one output, the smoothing is done afterwards and isn't part of the key
+	hash.addData(QString("frameCountDivisor=%1;frameSizeDivisor=%2;estimator=%3;maskRectangles=%4;autoMaskDuration=%5;autoMaskThreshold=%6;")
+		.arg(settings->video.frameCountDivisor)
+		.arg(settings->stabilizer.frameSizeDivisor)
+		.arg((int)settings->stabilizer.estimator)
+		.arg(settings->stabilizer.maskRectangles)
+		.arg(settings->stabilizer.autoMaskDuration)
+		.arg(settings->stabilizer.autoMaskThreshold).toUtf8());
+
+	hash.addData(QString("useTelemetry=%1;telemetryFieldOfView=%2;telemetryAxisOrder=%3;")
+		.arg(settings->stabilizer.useTelemetry ? 1 : 0)
+		.arg(settings->stabilizer.telemetryFieldOfView)
+		.arg(settings->stabilizer.telemetryAxisOrder).toUtf8());
+
+	fingerprint = QString(hash.result().toHex());
+
+	return true;
+}
+
+bool StabilizerCache::hasCumulativeFramePositions() const
+{
+	return !cacheFilePath.isEmpty() && QFile::exists(cacheFilePath);
+}
+
+bool StabilizerCache::readCumulativeFramePositions(std::vector<FramePosition>& framePositions)
+{
+	framePositions.clear();
+
+	if (!hasCumulativeFramePositions())
+		return false;
+
+	QFile file(cacheFilePath);
+
+	if (!file.open(QFile::ReadOnly | QFile::Text))
+	{
+		qWarning("Could not open stabilizer cache file");
+		return false;
+	}
+
+	QTextStream fileStream(&file);
+	QString fileInString = fileStream.readAll();
+	file.close();
+
+	QStringList lines = fileInString.split('\n');
+
+	if (lines.at(0).trimmed() != QString("fingerprint;%1").arg(fingerprint))
+	{
+		qWarning("Stabilizer cache file does not match the video");
+		return false;
+	}
+
+	for (int i = 1; i < lines.size(); ++i)
+	{
+		QStringList parts = lines.at(i).split(';');
+
+		if (parts.size() == 4)
+		{
+			FramePosition fp;
+
+			fp.timeStamp = (int64_t)parts[0].toLongLong();
+			fp.x = parts[1].toDouble();
+			fp.y = parts[2].toDouble();
+			fp.angle = parts[3].toDouble();
+
+			framePositions.push_back(fp);
+		}
+	}
+
+	if (framePositions.empty())
+	{
+		qWarning("Stabilizer cache file is empty");
+		return false;
+	}
+
+	// the positions are searched by time stamp, so they have to be increasing and inside the video
+	for (size_t i = 1; i < framePositions.size(); ++i)
+	{
+		if (framePositions.at(i).timeStamp <= framePositions.at(i - 1).timeStamp)
+		{
+			qWarning("Stabilizer cache file has unordered time stamps");
+			framePositions.clear();
+			return false;
+		}
+	}
+
+	if (videoDuration > 0 && (framePositions.front().timeStamp < videoStartTime || framePositions.back().timeStamp > videoStartTime + videoDuration + videoDuration / 100))
+	{
+		qWarning("Stabilizer cache file time stamps are outside the video");
+		framePositions.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool StabilizerCache::storeCumulativeFramePositions(const QString& fileName)
+{
+	if (cacheFilePath.isEmpty())
+		return false;
+
+	QFile fileIn(fileName);
+
+	if (!fileIn.open(QFile::ReadOnly | QFile::Text))
+	{
+		qWarning("Could not open pass one output file for caching");
+		return false;
+	}
+
+	QByteArray data = fileIn.readAll();
+	fileIn.close();
+
+	// replace the column header with the fingerprint
+	int headerEnd = data.indexOf('\n');
+
+	if (headerEnd < 0 || !data.startsWith("timeStamp;"))
+	{
+		qWarning("Pass one output file has an unknown format");
+		return false;
+	}
+
+	if (!QDir().mkpath(QFileInfo(cacheFilePath).absolutePath()))
+	{
+		qWarning("Could not create stabilizer cache directory");
+		return false;
+	}
+
+	QFile fileOut(cacheFilePath);
+
+	if (!fileOut.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+	{
+		qWarning("Could not open stabilizer cache file");
+		return false;
+	}
+
+	fileOut.write(QString("fingerprint;%1\n").arg(fingerprint).toUtf8());
+	fileOut.write(data.mid(headerEnd + 1));
+	fileOut.close();
+
+	qDebug("Stored stabilizer results to %s", qPrintable(cacheFilePath));
+
+	return true;
+}
+
+bool StabilizerCache::copyCumulativeFramePositions(const QString& fileName)
+{
+	std::vector<FramePosition> framePositions;
+
+	if (!readCumulativeFramePositions(framePositions))
+		return false;
+
+	QFile fileOut(fileName);
+
+	if (!fileOut.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+	{
+		qWarning("Could not open output file");
+		return false;
+	}
+
+	fileOut.write(passOneHeader);
+
+	for (const FramePosition& fp : framePositions)
+	{
+		char buffer[1024];
+		sprintf(buffer, "%lld;%.16le;%.16le;%.16le\n", (long long int)fp.timeStamp, fp.x, fp.y, fp.angle);
+		fileOut.write(buffer);
+	}
+
+	fileOut.close();
+
+	return true;
+}
+
+QString StabilizerCache::getFingerprint() const
+{
+	return fingerprint;
+}
+
+QString StabilizerCache::getCacheFilePath() const
+{
+	return cacheFilePath;
+}
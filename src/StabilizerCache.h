@@ -0,0 +1,42 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <QString>
+
+#include "VideoStabilizer.h"
+
+namespace OrientView
+{
+	class Settings;
+
+	// Store and look up cumulative stabilizer results by a fingerprint of the video content and the analysis settings.
+	class StabilizerCache
+	{
+
+	public:
+
+		bool initialize(Settings* settings);
+
+		bool hasCumulativeFramePositions() const;
+		bool readCumulativeFramePositions(std::vector<FramePosition>& framePositions);
+		bool storeCumulativeFramePositions(const QString& fileName);
+		bool copyCumulativeFramePositions(const QString& fileName);
+
+		QString getFingerprint() const;
+		QString getCacheFilePath() const;
+
+	private:
+
+		bool calculateFingerprint(Settings* settings);
+
+		QString fingerprint;
+		QString cacheFilePath;
+		int64_t videoStartTime = 0;
+		int64_t videoDuration = 0;
+	};
+}
@@ -0,0 +1,433 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+#include <QByteArray>
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+}
+
+#include "TelemetryReader.h"
+#include "Settings.h"
+
+using namespace OrientView;
+
+namespace
+{
+	// GPMF streams without an ORIN entry (HERO5 to HERO7) store the gyro channels as Z, X, Y.
+	const char* defaultGpmfAxisOrder = "ZXY";
+
+	// CAMM uses x right, y up and z backwards, which is y and z inverted compared to our camera axes.
+	const char* defaultCammAxisOrder = "Xyz";
+
+	struct GpmfStreamState
+	{
+		double scales[3] = { 1.0, 1.0, 1.0 };
+		QString orientation = defaultGpmfAxisOrder;
+	};
+
+	struct GpmfGyroBlock
+	{
+		QString orientation;
+		std::vector<double> values; // three values per sample
+	};
+
+	struct GpmfPacket
+	{
+		double startTime = 0.0;
+		double duration = 0.0;
+		QByteArray data;
+	};
+
+	uint16_t readUint16BigEndian(const uint8_t* data)
+	{
+		return (uint16_t)((data[0] << 8) | data[1]);
+	}
+
+	uint32_t readUint32BigEndian(const uint8_t* data)
+	{
+		return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+	}
+
+	uint32_t readUint32LittleEndian(const uint8_t* data)
+	{
+		return ((uint32_t)data[3] << 24) | ((uint32_t)data[2] << 16) | ((uint32_t)data[1] << 8) | (uint32_t)data[0];
+	}
+
+	float uint32ToFloat(uint32_t value)
+	{
+		float result;
+		memcpy(&result, &value, sizeof(float));
+		return result;
+	}
+
+	int getGpmfTypeSize(char type)
+	{
+		switch (type)
+		{
+			case 'b': case 'B': case 'c': return 1;
+			case 's': case 'S': return 2;
+			case 'l': case 'L': case 'f': return 4;
+			default: return 0;
+		}
+	}
+
+	double readGpmfValue(const uint8_t* data, char type)
+	{
+		switch (type)
+		{
+			case 'b': return (double)(int8_t)data[0];
+			case 'B': return (double)data[0];
+			case 's': return (double)(int16_t)readUint16BigEndian(data);
+			case 'S': return (double)readUint16BigEndian(data);
+			case 'l': return (double)(int32_t)readUint32BigEndian(data);
+			case 'L': return (double)readUint32BigEndian(data);
+			case 'f': return (double)uint32ToFloat(readUint32BigEndian(data));
+			default: return 0.0;
+		}
+	}
+
+	// Walk the GPMF key-length-value tree and collect the raw gyro samples of every stream.
+	void parseGpmf(const uint8_t* data, int size, GpmfStreamState& state, std::vector<GpmfGyroBlock>& gyroBlocks)
+	{
+		int offset = 0;
+
+		while (offset + 8 <= size)
+		{
+			const char* key = (const char*)(data + offset);
+			char type = (char)data[offset + 4];
+			int structSize = data[offset + 5];
+			int repeat = readUint16BigEndian(data + offset + 6);
+			int payloadSize = structSize * repeat;
+			const uint8_t* payload = data + offset + 8;
+
+			if (offset + 8 + payloadSize > size)
+				break;
+
+			if (type == 0)
+			{
+				if (strncmp(key, "STRM", 4) == 0)
+				{
+					GpmfStreamState streamState;
+					parseGpmf(payload, payloadSize, streamState, gyroBlocks);
+				}
+				else
+					parseGpmf(payload, payloadSize, state, gyroBlocks);
+			}
+			else if (strncmp(key, "SCAL", 4) == 0)
+			{
+				int typeSize = getGpmfTypeSize(type);
+				int valueCount = (typeSize > 0) ? (payloadSize / typeSize) : 0;
+
+				for (int i = 0; i < 3 && valueCount > 0; ++i)
+					state.scales[i] = readGpmfValue(payload + typeSize * std::min(i, valueCount - 1), type);
+			}
+			else if (strncmp(key, "ORIN", 4) == 0 && type == 'c')
+			{
+				state.orientation = QString::fromLatin1((const char*)payload, payloadSize).remove(QChar('\0')).trimmed();
+			}
+			else if (strncmp(key, "GYRO", 4) == 0)
+			{
+				int typeSize = getGpmfTypeSize(type);
+
+				if (typeSize > 0 && structSize / typeSize >= 3)
+				{
+					GpmfGyroBlock gyroBlock;
+					gyroBlock.orientation = state.orientation;
+
+					for (int i = 0; i < repeat; ++i)
+					{
+						for (int j = 0; j < 3; ++j)
+						{
+							double scale = (state.scales[j] != 0.0) ? state.scales[j] : 1.0;
+							gyroBlock.values.push_back(readGpmfValue(payload + i * structSize + j * typeSize, type) / scale);
+						}
+					}
+
+					gyroBlocks.push_back(gyroBlock);
+				}
+			}
+
+			// payloads are padded to 32 bits
+			offset += 8 + ((payloadSize + 3) & ~3);
+		}
+	}
+}
+
+bool TelemetryReader::initialize(Settings* settings)
+{
+	qDebug("Reading telemetry (%s)", qPrintable(settings->video.inputVideoFilePath));
+
+	axisOrderOverride = settings->stabilizer.telemetryAxisOrder.trimmed();
+	gyroSamples.clear();
+	cumulativeFramePositions.clear();
+
+	av_register_all();
+
+	AVFormatContext* formatContext = nullptr;
+
+	if (avformat_open_input(&formatContext, settings->video.inputVideoFilePath.toUtf8().constData(), nullptr, nullptr) < 0)
+	{
+		qWarning("Could not open source file");
+		return false;
+	}
+
+	if (avformat_find_stream_info(formatContext, nullptr) < 0)
+	{
+		qWarning("Could not find stream information");
+		avformat_close_input(&formatContext);
+		return false;
+	}
+
+	int videoStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	int gpmfStreamIndex = -1;
+	int cammStreamIndex = -1;
+
+	for (int i = 0; i < (int)formatContext->nb_streams; ++i)
+	{
+		unsigned int codecTag = formatContext->streams[i]->codec->codec_tag;
+
+		if (codecTag == MKTAG('g', 'p', 'm', 'd') && gpmfStreamIndex < 0)
+			gpmfStreamIndex = i;
+		else if (codecTag == MKTAG('c', 'a', 'm', 'm') && cammStreamIndex < 0)
+			cammStreamIndex = i;
+	}
+
+	if (videoStreamIndex < 0 || (gpmfStreamIndex < 0 && cammStreamIndex < 0))
+	{
+		qWarning("Could not find a video stream and a GPMF or CAMM telemetry stream in input file");
+		avformat_close_input(&formatContext);
+		return false;
+	}
+
+	AVStream* videoStream = formatContext->streams[videoStreamIndex];
+	int telemetryStreamIndex = (gpmfStreamIndex >= 0) ? gpmfStreamIndex : cammStreamIndex;
+	double telemetryTimeBase = av_q2d(formatContext->streams[telemetryStreamIndex]->time_base);
+
+	// small angle projection of a camera rotation into a displacement relative to the frame size
+	double tanHalfFieldOfView = tan(settings->stabilizer.telemetryFieldOfView * M_PI / 360.0);
+	horizontalFactor = 1.0 / (2.0 * tanHalfFieldOfView);
+	verticalFactor = horizontalFactor * videoStream->codec->width / std::max(1, videoStream->codec->height);
+
+	std::vector<int64_t> frameTimeStamps;
+	std::vector<GpmfPacket> gpmfPackets;
+
+	AVPacket packet;
+	av_init_packet(&packet);
+	packet.data = nullptr;
+	packet.size = 0;
+
+	// only demux, nothing is decoded
+	while (av_read_frame(formatContext, &packet) >= 0)
+	{
+		int64_t timeStamp = (packet.pts != AV_NOPTS_VALUE) ? packet.pts : packet.dts;
+
+		if (packet.stream_index == videoStreamIndex && timeStamp != AV_NOPTS_VALUE)
+			frameTimeStamps.push_back(timeStamp);
+		else if (packet.stream_index == telemetryStreamIndex && timeStamp != AV_NOPTS_VALUE)
+		{
+			if (telemetryStreamIndex == gpmfStreamIndex)
+			{
+				GpmfPacket gpmfPacket;
+				gpmfPacket.startTime = timeStamp * telemetryTimeBase;
+				gpmfPacket.duration = packet.duration * telemetryTimeBase;
+				gpmfPacket.data = QByteArray((const char*)packet.data, packet.size);
+				gpmfPackets.push_back(gpmfPacket);
+			}
+			else
+				readCammPacket(packet.data, packet.size, timeStamp * telemetryTimeBase);
+		}
+
+		av_free_packet(&packet);
+	}
+
+	avformat_close_input(&formatContext);
+
+	for (size_t i = 0; i < gpmfPackets.size(); ++i)
+	{
+		GpmfPacket& gpmfPacket = gpmfPackets.at(i);
+
+		if (gpmfPacket.duration <= 0.0 && i + 1 < gpmfPackets.size())
+			gpmfPacket.duration = gpmfPackets.at(i + 1).startTime - gpmfPacket.startTime;
+		else if (gpmfPacket.duration <= 0.0 && i > 0)
+			gpmfPacket.duration = gpmfPackets.at(i - 1).duration;
+
+		readGpmfPacket((const uint8_t*)gpmfPacket.data.constData(), gpmfPacket.data.size(), gpmfPacket.startTime, gpmfPacket.duration);
+	}
+
+	if (gyroSamples.size() < 2 || frameTimeStamps.empty())
+	{
+		qWarning("Could not find enough gyro samples in the telemetry stream");
+		return false;
+	}
+
+	std::sort(gyroSamples.begin(), gyroSamples.end(), [](const GyroSample& a, const GyroSample& b) { return a.time < b.time; });
+	std::sort(frameTimeStamps.begin(), frameTimeStamps.end());
+
+	integrateGyroSamples(frameTimeStamps, av_q2d(videoStream->time_base));
+
+	qDebug("Read %d gyro samples for %d frames", (int)gyroSamples.size(), (int)cumulativeFramePositions.size());
+
+	return true;
+}
+
+void TelemetryReader::writeCumulativeFramePositions(QFile& file)
+{
+	file.write("timeStamp;cumulativeX;cumulativeY;cumulativeAngle\n");
+
+	for (const FramePosition& fp : cumulativeFramePositions)
+	{
+		char buffer[1024];
+		sprintf(buffer, "%lld;%.16le;%.16le;%.16le\n", (long long int)fp.timeStamp, fp.x, fp.y, fp.angle);
+		file.write(buffer);
+	}
+}
+
+const std::vector<GyroSample>& TelemetryReader::getGyroSamples() const
+{
+	return gyroSamples;
+}
+
+const std::vector<FramePosition>& TelemetryReader::getCumulativeFramePositions() const
+{
+	return cumulativeFramePositions;
+}
+
+void TelemetryReader::readGpmfPacket(const uint8_t* data, int size, double startTime, double duration)
+{
+	GpmfStreamState state;
+	std::vector<GpmfGyroBlock> gyroBlocks;
+
+	parseGpmf(data, size, state, gyroBlocks);
+
+	// the samples of a packet are spread evenly over its duration
+	for (const GpmfGyroBlock& gyroBlock : gyroBlocks)
+	{
+		int sampleCount = (int)gyroBlock.values.size() / 3;
+
+		for (int i = 0; i < sampleCount; ++i)
+			addGyroSample(startTime + duration * i / sampleCount, &gyroBlock.values[i * 3], 3, gyroBlock.orientation);
+	}
+}
+
+void TelemetryReader::readCammPacket(const uint8_t* data, int size, double time)
+{
+	// uint16 reserved, uint16 type, then type specific data (little endian)
+	if (size < 4 + 3 * 4)
+		return;
+
+	int type = data[2] | (data[3] << 8);
+
+	// type 2 is the gyroscope in radians per second
+	if (type != 2)
+		return;
+
+	double values[3];
+
+	for (int i = 0; i < 3; ++i)
+		values[i] = (double)uint32ToFloat(readUint32LittleEndian(data + 4 + i * 4));
+
+	addGyroSample(time, values, 3, defaultCammAxisOrder);
+}
+
+void TelemetryReader::addGyroSample(double time, const double* values, int valueCount, const QString& axisOrder)
+{
+	// every letter names the camera axis of one channel, lower case means the channel is inverted
+	QString order = axisOrderOverride.isEmpty() ? axisOrder : axisOrderOverride;
+
+	if (order.length() != 3 || valueCount < 3)
+		order = "XYZ";
+
+	double axes[3] = { 0.0, 0.0, 0.0 };
+
+	for (int i = 0; i < 3; ++i)
+	{
+		char letter = order.at(i).toLatin1();
+		int axis = toupper(letter) - 'X';
+
+		if (axis >= 0 && axis < 3)
+			axes[axis] = islower(letter) ? -values[i] : values[i];
+	}
+
+	GyroSample sample;
+	sample.time = time;
+	sample.x = axes[0];
+	sample.y = axes[1];
+	sample.z = axes[2];
+
+	gyroSamples.push_back(sample);
+}
+
+void TelemetryReader::integrateGyroSamples(const std::vector<int64_t>& frameTimeStamps, double timeBase)
+{
+	size_t sampleCount = gyroSamples.size();
+
+	std::vector<double> angleX(sampleCount, 0.0);
+	std::vector<double> angleY(sampleCount, 0.0);
+	std::vector<double> angleZ(sampleCount, 0.0);
+
+	// trapezoidal integration of the angular velocities
+	for (size_t i = 1; i < sampleCount; ++i)
+	{
+		const GyroSample& previous = gyroSamples.at(i - 1);
+		const GyroSample& current = gyroSamples.at(i);
+		double deltaTime = current.time - previous.time;
+
+		angleX[i] = angleX[i - 1] + 0.5 * (previous.x + current.x) * deltaTime;
+		angleY[i] = angleY[i - 1] + 0.5 * (previous.y + current.y) * deltaTime;
+		angleZ[i] = angleZ[i - 1] + 0.5 * (previous.z + current.z) * deltaTime;
+	}
+
+	auto comparator = [](const double time, const GyroSample& sample) { return time < sample.time; };
+
+	cumulativeFramePositions.clear();
+
+	for (int64_t frameTimeStamp : frameTimeStamps)
+	{
+		double time = frameTimeStamp * timeBase;
+		size_t next = std::upper_bound(gyroSamples.begin(), gyroSamples.end(), time, comparator) - gyroSamples.begin();
+
+		double pitch = 0.0;
+		double yaw = 0.0;
+		double roll = 0.0;
+
+		if (next == 0)
+		{
+			pitch = angleX.front();
+			yaw = angleY.front();
+			roll = angleZ.front();
+		}
+		else if (next >= sampleCount)
+		{
+			pitch = angleX.back();
+			yaw = angleY.back();
+			roll = angleZ.back();
+		}
+		else
+		{
+			double previousTime = gyroSamples.at(next - 1).time;
+			double nextTime = gyroSamples.at(next).time;
+			double alpha = (nextTime > previousTime) ? (time - previousTime) / (nextTime - previousTime) : 0.0;
+
+			pitch = angleX[next - 1] + alpha * (angleX[next] - angleX[next - 1]);
+			yaw = angleY[next - 1] + alpha * (angleY[next] - angleY[next - 1]);
+			roll = angleZ[next - 1] + alpha * (angleZ[next] - angleZ[next - 1]);
+		}
+
+		// turning right moves the image content left, tilting up moves it down and rolling clockwise rotates it counterclockwise
+		FramePosition fp;
+		fp.timeStamp = frameTimeStamp;
+		fp.x = -yaw * horizontalFactor;
+		fp.y = pitch * verticalFactor;
+		fp.angle = -roll * 180.0 / M_PI;
+
+		cumulativeFramePositions.push_back(fp);
+	}
+}
@@ -0,0 +1,54 @@
+// Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: GPLv3, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <QFile>
+#include <QString>
+
+#include "VideoStabilizer.h"
+
+namespace OrientView
+{
+	class Settings;
+
+	// Angular velocity in radians per second, in camera axes (x right, y down, z forward).
+	struct GyroSample
+	{
+		double time = 0.0;
+		double x = 0.0;
+		double y = 0.0;
+		double z = 0.0;
+	};
+
+	// Read the gyroscope track (GoPro GPMF or CAMM) from a video file and integrate it into cumulative frame positions.
+	class TelemetryReader
+	{
+
+	public:
+
+		bool initialize(Settings* settings);
+		void writeCumulativeFramePositions(QFile& file);
+
+		const std::vector<GyroSample>& getGyroSamples() const;
+		const std::vector<FramePosition>& getCumulativeFramePositions() const;
+
+	private:
+
+		void readGpmfPacket(const uint8_t* data, int size, double startTime, double duration);
+		void readCammPacket(const uint8_t* data, int size, double time);
+		void addGyroSample(double time, const double* values, int valueCount, const QString& axisOrder);
+		void integrateGyroSamples(const std::vector<int64_t>& frameTimeStamps, double timeBase);
+
+		QString axisOrderOverride;
+
+		double horizontalFactor = 0.0;
+		double verticalFactor = 0.0;
+
+		std::vector<GyroSample> gyroSamples;
+		std::vector<FramePosition> cumulativeFramePositions;
+	};
+}
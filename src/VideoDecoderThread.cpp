@@ -1,19 +1,28 @@
 // Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
 // License: GPLv3, see the LICENSE file.
 
+#include <algorithm>
+#include <cstring>
+
 #include "VideoDecoderThread.h"
 #include "VideoDecoder.h"
+#include "VideoStabilizer.h"
+#include "Settings.h"
 
 using namespace OrientView;
 
-void VideoDecoderThread::initialize(VideoDecoder* videoDecoder)
+void VideoDecoderThread::initialize(VideoDecoder* videoDecoder, VideoStabilizer* videoStabilizer, Settings* settings)
 {
 	this->videoDecoder = videoDecoder;
+	this->videoStabilizer = videoStabilizer;
 
 	frameReadSemaphore = new QSemaphore();
 	frameAvailableSemaphore = new QSemaphore();
 	decodedFrameData = FrameData();
 	decodedFrameDataGrayscale = FrameData();
+
+	if (settings->stabilizer.mode == VideoStabilizerMode::RealTimeLookahead)
+		lookaheadFrameCount = std::max(1, settings->stabilizer.lookaheadFrameCount);
 }
 
 VideoDecoderThread::~VideoDecoderThread()
@@ -29,6 +38,21 @@ VideoDecoderThread::~VideoDecoderThread()
 		delete frameReadSemaphore;
 		frameReadSemaphore = nullptr;
 	}
+
+	if (lookaheadFrameCount > 0)
+	{
+		if (decodedFrameData.data != nullptr)
+			freeFrameBuffers.push_back(decodedFrameData.data);
+
+		for (LookaheadFrame& lookaheadFrame : lookaheadFrames)
+			freeFrameBuffers.push_back(lookaheadFrame.frameData.data);
+
+		for (uint8_t* frameBuffer : freeFrameBuffers)
+			delete[] frameBuffer;
+
+		lookaheadFrames.clear();
+		freeFrameBuffers.clear();
+	}
 }
 
 void VideoDecoderThread::run()
@@ -42,7 +66,17 @@ void VideoDecoderThread::run()
 		if (isInterruptionRequested())
 			break;
 
-		if (videoDecoder->getNextFrame(&decodedFrameData, &decodedFrameDataGrayscale))
+		bool gotFrame = false;
+
+		if (lookaheadFrameCount > 0)
+			gotFrame = getNextLookaheadFrame();
+		else
+			gotFrame = videoDecoder->getNextFrame(&decodedFrameData, &decodedFrameDataGrayscale);
+
+		// also the buffered lookahead frames have been handed out
+		isFinished = !gotFrame && videoDecoder->getIsFinished();
+
+		if (gotFrame)
 			frameAvailableSemaphore->release(1);
 		else
 			QThread::msleep(100);
@@ -66,3 +100,90 @@ void VideoDecoderThread::signalFrameRead()
 {
 	frameReadSemaphore->release(1);
 }
+
+void VideoDecoderThread::resetAfterSeek()
+{
+	// the buffered frames were analyzed before the seek, so with lookahead the stabilizer is reset on the decoder thread together with them
+	if (lookaheadFrameCount > 0)
+		shouldResetLookahead = true;
+	else
+		videoStabilizer->reset();
+}
+
+double VideoDecoderThread::getCurrentTime()
+{
+	if (lookaheadFrameCount > 0)
+		return decodedCurrentTime;
+	else
+		return videoDecoder->getCurrentTime();
+}
+
+bool VideoDecoderThread::getIsFinished() const
+{
+	return isFinished;
+}
+
+bool VideoDecoderThread::getNextLookaheadFrame()
+{
+	// the previously handed out frame has been read, so its buffer can be reused
+	if (decodedFrameData.data != nullptr)
+	{
+		freeFrameBuffers.push_back(decodedFrameData.data);
+		decodedFrameData.data = nullptr;
+	}
+
+	// buffered frames are from before a seek, throw them away before any frame after the seek is analyzed
+	if (shouldResetLookahead.exchange(false))
+	{
+		for (LookaheadFrame& lookaheadFrame : lookaheadFrames)
+			freeFrameBuffers.push_back(lookaheadFrame.frameData.data);
+
+		lookaheadFrames.clear();
+		videoStabilizer->reset();
+	}
+
+	// keep the decoder lookaheadFrameCount frames ahead of the displayed frame so that the stabilizer can see into the future
+	while ((int)lookaheadFrames.size() <= lookaheadFrameCount)
+	{
+		FrameData frameData;
+		FrameData frameDataGrayscale;
+
+		if (!videoDecoder->getNextFrame(&frameData, &frameDataGrayscale))
+			break;
+
+		videoStabilizer->analyzeFrame(frameDataGrayscale);
+
+		uint8_t* frameBuffer = nullptr;
+
+		if (!freeFrameBuffers.empty())
+		{
+			frameBuffer = freeFrameBuffers.back();
+			freeFrameBuffers.pop_back();
+		}
+		else
+			frameBuffer = new uint8_t[frameData.dataLength];
+
+		memcpy(frameBuffer, frameData.data, frameData.dataLength);
+
+		LookaheadFrame lookaheadFrame;
+		lookaheadFrame.frameData = frameData;
+		lookaheadFrame.frameData.data = frameBuffer;
+		lookaheadFrame.frameDataGrayscale = frameDataGrayscale;
+		lookaheadFrame.frameDataGrayscale.data = nullptr; // already analyzed, the stabilizer only needs the time stamp from now on
+		lookaheadFrame.currentTime = videoDecoder->getCurrentTime();
+
+		lookaheadFrames.push_back(lookaheadFrame);
+	}
+
+	if (lookaheadFrames.empty())
+		return false;
+
+	LookaheadFrame lookaheadFrame = lookaheadFrames.front();
+	lookaheadFrames.pop_front();
+
+	decodedFrameData = lookaheadFrame.frameData;
+	decodedFrameDataGrayscale = lookaheadFrame.frameDataGrayscale;
+	decodedCurrentTime = lookaheadFrame.currentTime;
+
+	return true;
+}
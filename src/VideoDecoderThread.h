@@ -3,6 +3,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
 #include <QThread>
 #include <QSemaphore>
 
@@ -11,6 +16,15 @@
 namespace OrientView
 {
 	class VideoDecoder;
+	class VideoStabilizer;
+	class Settings;
+
+	struct LookaheadFrame
+	{
+		FrameData frameData;
+		FrameData frameDataGrayscale;
+		double currentTime = 0.0;
+	};
 
 	// Run video decoder on a thread.
 	class VideoDecoderThread : public QThread
@@ -19,24 +33,39 @@ namespace OrientView
 
 	public:
 
-		void initialize(VideoDecoder* videoDecoder);
+		void initialize(VideoDecoder* videoDecoder, VideoStabilizer* videoStabilizer, Settings* settings);
 		~VideoDecoderThread();
 
 		bool tryGetNextFrame(FrameData& frameData, FrameData& frameDataGrayscale, int timeout);
 		void signalFrameRead();
 
+		void resetAfterSeek();
+		double getCurrentTime();
+		bool getIsFinished() const;
+
 	protected:
 
 		void run();
 
 	private:
 
+		bool getNextLookaheadFrame();
+
 		VideoDecoder* videoDecoder = nullptr;
+		VideoStabilizer* videoStabilizer = nullptr;
 
 		QSemaphore* frameReadSemaphore = nullptr;
 		QSemaphore* frameAvailableSemaphore = nullptr;
 
 		FrameData decodedFrameData;
 		FrameData decodedFrameDataGrayscale;
+		std::atomic<double> decodedCurrentTime { 0.0 };
+
+		int lookaheadFrameCount = 0;
+		std::atomic<bool> shouldResetLookahead { false };
+		std::atomic<bool> isFinished { false };
+
+		std::deque<LookaheadFrame> lookaheadFrames;
+		std::vector<uint8_t*> freeFrameBuffers;
 	};
 }
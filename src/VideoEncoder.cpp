@@ -1,6 +1,8 @@
 // Copyright © 2014 Mikko Ronkainen <firstname@mikkoronkainen.com>
 // License: GPLv3, see the LICENSE file.
 
+#include <cstring>
+
 #include "VideoEncoder.h"
 #include "VideoDecoder.h"
 #include "Settings.h"
@@ -32,6 +34,13 @@ bool VideoEncoder::initialize(VideoDecoder* videoDecoder, Settings* settings)
 	param.rc.f_rf_constant = settings->encoder.constantRateFactor;
 	param.i_log_level = X264_LOG_NONE;
 
+	// both the GPU and the CPU conversion produce BT.709 limited range with left chroma siting
+	param.vui.i_colorprim = 1;
+	param.vui.i_transfer = 1;
+	param.vui.i_colmatrix = 1;
+	param.vui.b_fullrange = 0;
+	param.vui.i_chroma_loc = 0;
+
 	x264_param_apply_fastfirstpass(&param);
 
 	if (x264_param_apply_profile(&param, qPrintable(settings->encoder.profile)) < 0)
@@ -70,6 +79,9 @@ bool VideoEncoder::initialize(VideoDecoder* videoDecoder, Settings* settings)
 		return false;
 	}
 
+	const int* colorCoefficients = sws_getCoefficients(SWS_CS_ITU709);
+	sws_setColorspaceDetails(swsContext, colorCoefficients, 1, colorCoefficients, 0, 0, 1 << 16, 1 << 16);
+
 	mp4File = new Mp4File();
 
 	if (!mp4File->open(settings->encoder.outputVideoFilePath))
@@ -125,7 +137,37 @@ void VideoEncoder::readFrameData(const FrameData& frameData)
 {
 	encodeDurationTimer.restart();
 
-	sws_scale(swsContext, &frameData.data, (int*)(&frameData.rowLength), 0, frameData.height, convertedPicture->img.plane, convertedPicture->img.i_stride);
+	// already converted by the renderer, only the planes need to be copied
+	if (frameData.isPlanarYuv)
+	{
+		int width = frameData.width;
+		int height = frameData.height;
+		const uint8_t* source = frameData.data;
+
+		for (int plane = 0; plane < 3; ++plane)
+		{
+			int planeWidth = (plane == 0) ? width : width / 2;
+			int planeHeight = (plane == 0) ? height : height / 2;
+			uint8_t* destination = convertedPicture->img.plane[plane];
+			int destinationStride = convertedPicture->img.i_stride[plane];
+
+			if (destinationStride == planeWidth)
+			{
+				memcpy(destination, source, (size_t)(planeWidth * planeHeight));
+				source += planeWidth * planeHeight;
+			}
+			else
+			{
+				for (int y = 0; y < planeHeight; ++y)
+				{
+					memcpy(destination + y * destinationStride, source, (size_t)planeWidth);
+					source += planeWidth;
+				}
+			}
+		}
+	}
+	else
+		sws_scale(swsContext, &frameData.data, (int*)(&frameData.rowLength), 0, frameData.height, convertedPicture->img.plane, convertedPicture->img.i_stride);
 }
 
 int VideoEncoder::encodeFrame()
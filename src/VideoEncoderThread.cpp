@@ -46,7 +46,7 @@ void VideoEncoderThread::run()
 
 			emit frameProcessed(renderedFrameData.cumulativeNumber, frameSize, videoDecoder->getCurrentTime());
 		}
-		else if (videoDecoder->getIsFinished())
+		else if (renderOffScreenThread->getIsFinished())
 			break;
 	}
 
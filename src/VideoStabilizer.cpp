@@ -3,6 +3,7 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
 #include <cstdint>
 
 #include <QTextStream>
@@ -15,9 +16,86 @@
 
 using namespace OrientView;
 
-bool VideoStabilizer::initialize(Settings* settings, bool isPreprocessing)
+namespace
+{
+	// Average the cumulative positions inside a window centered on the given index.
+	template <typename T>
+	FramePosition calculateAverageFramePosition(const T& positions, int index, int smoothingRadius)
+	{
+		FramePosition average;
+		int sumCount = 0;
+
+		for (int j = -smoothingRadius; j <= smoothingRadius; ++j)
+		{
+			if ((index + j) >= 0 && (index + j) < (int)positions.size())
+			{
+				const FramePosition& fp = positions.at(index + j);
+
+				average.x += fp.x;
+				average.y += fp.y;
+				average.angle += fp.angle;
+
+				sumCount++;
+			}
+		}
+
+		if (sumCount > 0)
+		{
+			average.x /= (double)sumCount;
+			average.y /= (double)sumCount;
+			average.angle /= (double)sumCount;
+		}
+
+		return average;
+	}
+
+	std::vector<FramePosition> calculateNormalizedFramePositions(const std::vector<FramePosition>& cumulativeFramePositions, int smoothingRadius)
+	{
+		std::vector<FramePosition> normalizedFramePositions;
+
+		for (int i = 0; i < (int)cumulativeFramePositions.size(); ++i)
+		{
+			FramePosition averageFp = calculateAverageFramePosition(cumulativeFramePositions, i, smoothingRadius);
+			FramePosition currentFp = cumulativeFramePositions.at(i);
+			FramePosition normalizedFp;
+
+			normalizedFp.timeStamp = currentFp.timeStamp;
+			normalizedFp.x = averageFp.x - currentFp.x;
+			normalizedFp.y = averageFp.y - currentFp.y;
+			normalizedFp.angle = averageFp.angle - currentFp.angle;
+
+			normalizedFramePositions.push_back(normalizedFp);
+		}
+
+		return normalizedFramePositions;
+	}
+
+	struct StabilizerQuality
+	{
+		double imageScale;
+		int maxCorners;
+		int pyramidLevels;
+	};
+
+	// the default level matches the fixed settings, the levels above it only add work on top of the decoded grayscale resolution
+	const StabilizerQuality stabilizerQualities[] =
+	{
+		{ 0.5, 50, 2 },
+		{ 0.5, 100, 3 },
+		{ 0.75, 150, 3 },
+		{ 1.0, 200, 3 },
+		{ 1.0, 300, 4 },
+		{ 1.0, 400, 5 }
+	};
+
+	const int stabilizerQualityCount = sizeof(stabilizerQualities) / sizeof(stabilizerQualities[0]);
+	const int defaultStabilizerQuality = 3;
+}
+
+bool VideoStabilizer::initialize(Settings* settings, bool isPreprocessing, const QString& cacheFilePath)
 {
 	mode = settings->stabilizer.mode;
+	estimator = settings->stabilizer.estimator;
 	isEnabled = settings->stabilizer.enabled;
 	cumulativeXAverage.setAlpha(settings->stabilizer.averagingFactor);
 	cumulativeYAverage.setAlpha(settings->stabilizer.averagingFactor);
@@ -25,13 +103,56 @@ bool VideoStabilizer::initialize(Settings* settings, bool isPreprocessing)
 	dampingFactor = settings->stabilizer.dampingFactor;
 	maxDisplacementFactor = settings->stabilizer.maxDisplacementFactor;
 	maxAngle = settings->stabilizer.maxAngle;
+	lookaheadFrameCount = std::max(1, settings->stabilizer.lookaheadFrameCount);
+
+	// the window can't reach further into the future than the decoder has buffered
+	lookaheadSmoothingRadius = std::max(1, std::min(settings->stabilizer.smoothingRadius, lookaheadFrameCount));
+
+	autoMaskDuration = settings->stabilizer.autoMaskDuration;
+	autoMaskThreshold = settings->stabilizer.autoMaskThreshold;
+
+	// preprocessing has no deadline and should give the same result on every machine
+	useAdaptiveQuality = !isPreprocessing && mode != VideoStabilizerMode::Preprocessed && settings->stabilizer.adaptiveQuality;
+	adaptiveBudgetFactor = settings->stabilizer.adaptiveBudgetFactor;
+	qualityLevel = defaultStabilizerQuality;
+	qualityLevelFrameCount = 0;
+	analysisDurationAverage.setAlpha(0.1);
+
+	maskRectangles.clear();
+
+	// normalized x,y,width,height separated by semicolons
+	for (const QString& maskRectangleString : settings->stabilizer.maskRectangles.split(';', QString::SkipEmptyParts))
+	{
+		QStringList parts = maskRectangleString.split(',');
+
+		if (parts.size() == 4)
+			maskRectangles.push_back(cv::Rect_<double>(parts[0].toDouble(), parts[1].toDouble(), parts[2].toDouble(), parts[3].toDouble()));
+		else
+			qWarning("Invalid stabilizer mask rectangle: %s", qPrintable(maskRectangleString));
+	}
+
+	// the masks are kept over seeks and resets, only a new initialization rebuilds them
+	featureMask = cv::Mat();
+	staticPixelMask = cv::Mat();
+	differenceSum = cv::Mat();
 
 	reset();
 
 	if (!isPreprocessing && mode == VideoStabilizerMode::Preprocessed)
 	{
-		if (!readNormalizedFramePositions(settings->stabilizer.inputDataFilePath))
-			return false;
+		// an explicitly selected pass two file wins, the cached pass one results are only used without one
+		if (!settings->stabilizer.inputDataFilePath.isEmpty() || cacheFilePath.isEmpty())
+		{
+			if (!readNormalizedFramePositions(settings->stabilizer.inputDataFilePath))
+				return false;
+		}
+		else
+		{
+			if (!readCumulativeFramePositions(cacheFilePath, settings->stabilizer.smoothingRadius))
+				return false;
+
+			qDebug("Using cached stabilizer results from %s", qPrintable(cacheFilePath));
+		}
 	}
 
 	return true;
@@ -46,6 +167,24 @@ void VideoStabilizer::preProcessFrame(const FrameData& frameDataGrayscale, QFile
 	file.write(buffer);
 }
 
+void VideoStabilizer::analyzeFrame(const FrameData& frameDataGrayscale)
+{
+	if (!isEnabled || mode != VideoStabilizerMode::RealTimeLookahead)
+		return;
+
+	QMutexLocker locker(&lookaheadMutex);
+
+	analyzeDurationTimer.restart();
+
+	lookaheadFramePositions.push_back(calculateCumulativeFramePosition(frameDataGrayscale));
+
+	// the displayed frame should consume these, but never let the buffer grow without bounds
+	while ((int)lookaheadFramePositions.size() > 4 * lookaheadFrameCount + 2)
+		lookaheadFramePositions.pop_front();
+
+	analyzeDuration = analyzeDurationTimer.nsecsElapsed() / 1000000.0;
+}
+
 void VideoStabilizer::processFrame(const FrameData& frameDataGrayscale)
 {
 	if (!isEnabled)
@@ -55,6 +194,8 @@ void VideoStabilizer::processFrame(const FrameData& frameDataGrayscale)
 
 	if (mode == VideoStabilizerMode::Preprocessed)
 		normalizedFramePosition = searchNormalizedFramePosition(frameDataGrayscale);
+	else if (mode == VideoStabilizerMode::RealTimeLookahead)
+		normalizedFramePosition = searchLookaheadFramePosition(frameDataGrayscale);
 	else
 	{
 		FramePosition cumulativeFramePosition = calculateCumulativeFramePosition(frameDataGrayscale);
@@ -81,45 +222,43 @@ void VideoStabilizer::processFrame(const FrameData& frameDataGrayscale)
 
 FramePosition VideoStabilizer::calculateCumulativeFramePosition(const FrameData& frameDataGrayscale)
 {
+	analysisDurationTimer.restart();
+
 	cv::Mat currentImage(frameDataGrayscale.height, frameDataGrayscale.width, CV_8UC1, frameDataGrayscale.data);
+	const StabilizerQuality& quality = stabilizerQualities[qualityLevel];
+
+	if (quality.imageScale < 1.0)
+	{
+		cv::resize(currentImage, scaledImage, cv::Size(), quality.imageScale, quality.imageScale, cv::INTER_AREA);
+		currentImage = scaledImage;
+	}
 
 	if (isFirstImage)
 	{
-		previousImage = cv::Mat(frameDataGrayscale.height, frameDataGrayscale.width, CV_8UC1);
 		currentImage.copyTo(previousImage);
+		previousImageFloat = cv::Mat();
+		previousLogPolarSpectrum = cv::Mat();
 		isFirstImage = false;
 	}
 
-	std::vector<cv::Point2f> previousCorners;
-	std::vector<cv::Point2f> previousCornersFiltered;
-	std::vector<cv::Point2f> currentCorners;
-	std::vector<cv::Point2f> currentCornersFiltered;
-	std::vector<uchar> opticalFlowStatus;
-	std::vector<float> opticalFlowError;
-
-	// find good trackable feature points from the previous image
-	cv::goodFeaturesToTrack(previousImage, previousCorners, 200, 0.01, 30.0);
-
-	// find those same points in the current image
-	cv::calcOpticalFlowPyrLK(previousImage, currentImage, previousCorners, currentCorners, opticalFlowStatus, opticalFlowError);
-
-	currentImage.copyTo(previousImage);
-
-	// filter out points which didn't have a good match
-	for (size_t i = 0; i < opticalFlowStatus.size(); i++)
+	// the quality level changed the analysis resolution
+	if (previousImage.size() != currentImage.size())
 	{
-		if (opticalFlowStatus.at(i) != 0)
-		{
-			previousCornersFiltered.push_back(previousCorners.at(i));
-			currentCornersFiltered.push_back(currentCorners.at(i));
-		}
+		cv::resize(previousImage, previousImage, currentImage.size(), 0.0, 0.0, cv::INTER_AREA);
+		previousImageFloat = cv::Mat();
+		previousLogPolarSpectrum = cv::Mat();
 	}
 
+	updateFeatureMask(currentImage, frameDataGrayscale.duration);
+
 	cv::Mat currentTransformation;
 
-	// estimate the transformation between previous and current images trackable points
-	if (previousCornersFiltered.size() > 0 && currentCornersFiltered.size() > 0)
-		currentTransformation = cv::estimateRigidTransform(previousCornersFiltered, currentCornersFiltered, false);
+	if (estimator == VideoStabilizerEstimator::FeatureTracking)
+		currentTransformation = estimateFeatureTrackingTransformation(currentImage);
+	else
+		currentTransformation = estimatePhaseCorrelationTransformation(currentImage);
+
+	currentImage.copyTo(previousImage);
 
 	// sometimes the transformation could not be found, just use previous transformation
 	if (currentTransformation.data == nullptr)
@@ -134,8 +273,8 @@ FramePosition VideoStabilizer::calculateCumulativeFramePosition(const FrameData&
 
 	currentTransformation.copyTo(previousTransformation);
 
-	double deltaX = tx / frameDataGrayscale.width;
-	double deltaY = ty / frameDataGrayscale.height;
+	double deltaX = tx / currentImage.cols;
+	double deltaY = ty / currentImage.rows;
 	double deltaAngle = atan2(c, d) * 180.0 / M_PI;
 
 	cumulativeX += deltaX;
@@ -148,9 +287,242 @@ FramePosition VideoStabilizer::calculateCumulativeFramePosition(const FrameData&
 	fp.y = cumulativeY;
 	fp.angle = cumulativeAngle;
 
+	if (useAdaptiveQuality)
+		updateQualityLevel(analysisDurationTimer.nsecsElapsed() / 1000000.0, (frameDataGrayscale.duration / 1000.0) * adaptiveBudgetFactor);
+
 	return fp;
 }
 
+void VideoStabilizer::updateFeatureMask(const cv::Mat& currentImage, int64_t frameDuration)
+{
+	if (featureMask.size() != currentImage.size())
+	{
+		featureMask = cv::Mat(currentImage.size(), CV_8UC1, cv::Scalar(255));
+		correlationWindow = cv::Mat();
+
+		for (const cv::Rect_<double>& maskRectangle : maskRectangles)
+		{
+			cv::Rect rectangle((int)(maskRectangle.x * currentImage.cols), (int)(maskRectangle.y * currentImage.rows), (int)ceil(maskRectangle.width * currentImage.cols), (int)ceil(maskRectangle.height * currentImage.rows));
+			rectangle &= cv::Rect(0, 0, currentImage.cols, currentImage.rows);
+
+			if (rectangle.area() > 0)
+				featureMask(rectangle).setTo(cv::Scalar(0));
+		}
+
+		if (!staticPixelMask.empty())
+		{
+			cv::Mat scaledStaticPixelMask;
+			cv::resize(staticPixelMask, scaledStaticPixelMask, currentImage.size(), 0.0, 0.0, cv::INTER_NEAREST);
+			featureMask.setTo(cv::Scalar(0), scaledStaticPixelMask);
+		}
+	}
+
+	if (autoMaskDuration <= 0.0 || !staticPixelMask.empty())
+		return;
+
+	// collect how much every pixel changes during the first seconds, the ones that barely change belong to the camera or the rig
+	if (differenceSum.empty())
+	{
+		differenceSum = cv::Mat::zeros(currentImage.size(), CV_32FC1);
+		differenceCount = 0;
+		autoMaskElapsedTime = 0.0;
+	}
+
+	cv::Mat difference;
+
+	// the sum stays at the resolution it was started with, so quality level changes don't restart the collection
+	if (differenceSum.size() != currentImage.size())
+	{
+		cv::Mat scaledPreviousImage;
+		cv::Mat scaledCurrentImage;
+		cv::resize(previousImage, scaledPreviousImage, differenceSum.size(), 0.0, 0.0, cv::INTER_AREA);
+		cv::resize(currentImage, scaledCurrentImage, differenceSum.size(), 0.0, 0.0, cv::INTER_AREA);
+		cv::absdiff(scaledPreviousImage, scaledCurrentImage, difference);
+	}
+	else
+		cv::absdiff(previousImage, currentImage, difference);
+
+	cv::accumulate(difference, differenceSum);
+
+	differenceCount++;
+	autoMaskElapsedTime += frameDuration / 1000000.0;
+
+	if (autoMaskElapsedTime >= autoMaskDuration)
+	{
+		staticPixelMask = (differenceSum / (double)differenceCount) < autoMaskThreshold;
+		cv::dilate(staticPixelMask, staticPixelMask, cv::Mat(), cv::Point(-1, -1), 2);
+
+		cv::Mat scaledStaticPixelMask;
+		cv::resize(staticPixelMask, scaledStaticPixelMask, featureMask.size(), 0.0, 0.0, cv::INTER_NEAREST);
+		featureMask.setTo(cv::Scalar(0), scaledStaticPixelMask);
+		correlationWindow = cv::Mat();
+		differenceSum = cv::Mat();
+
+		qDebug("Masked %.1f%% of the frame as static", 100.0 * cv::countNonZero(staticPixelMask) / (double)staticPixelMask.total());
+	}
+}
+
+bool VideoStabilizer::isInsideFeatureMask(const cv::Point2f& point) const
+{
+	int x = (int)point.x;
+	int y = (int)point.y;
+
+	if (x < 0 || y < 0 || x >= featureMask.cols || y >= featureMask.rows)
+		return false;
+
+	return featureMask.at<uchar>(y, x) != 0;
+}
+
+void VideoStabilizer::updateQualityLevel(double analysisDuration, double frameBudget)
+{
+	if (frameBudget <= 0.0)
+		return;
+
+	// the average still describes the previous level right after a change
+	if (qualityLevelFrameCount == 0)
+		analysisDurationAverage.reset(analysisDuration);
+	else
+		analysisDurationAverage.addMeasurement(analysisDuration);
+
+	qualityLevelFrameCount++;
+
+	double averageDuration = analysisDurationAverage.getAverage();
+	int newQualityLevel = qualityLevel;
+
+	// drop right away when over the budget, rise only after staying well below it for a while
+	if (qualityLevel > 0 && (analysisDuration > frameBudget || (qualityLevelFrameCount >= 3 && averageDuration > 0.8 * frameBudget)))
+		newQualityLevel = qualityLevel - 1;
+	else if (qualityLevel < stabilizerQualityCount - 1 && qualityLevelFrameCount >= 60 && averageDuration < 0.4 * frameBudget)
+		newQualityLevel = qualityLevel + 1;
+
+	if (newQualityLevel != qualityLevel)
+	{
+		qualityLevel = newQualityLevel;
+		qualityLevelFrameCount = 0;
+	}
+}
+
+cv::Mat VideoStabilizer::estimateFeatureTrackingTransformation(const cv::Mat& currentImage)
+{
+	std::vector<cv::Point2f> previousCorners;
+	std::vector<cv::Point2f> previousCornersFiltered;
+	std::vector<cv::Point2f> currentCorners;
+	std::vector<cv::Point2f> currentCornersFiltered;
+	std::vector<uchar> opticalFlowStatus;
+	std::vector<float> opticalFlowError;
+
+	// find good trackable feature points from the previous image, ignoring the masked areas
+	const StabilizerQuality& quality = stabilizerQualities[qualityLevel];
+	cv::goodFeaturesToTrack(previousImage, previousCorners, quality.maxCorners, 0.01, 30.0 * quality.imageScale, featureMask);
+
+	if (previousCorners.empty())
+		return cv::Mat();
+
+	// find those same points in the current image
+	cv::calcOpticalFlowPyrLK(previousImage, currentImage, previousCorners, currentCorners, opticalFlowStatus, opticalFlowError, cv::Size(21, 21), quality.pyramidLevels);
+
+	// filter out points which didn't have a good match or which moved into a masked area
+	for (size_t i = 0; i < opticalFlowStatus.size(); i++)
+	{
+		if (opticalFlowStatus.at(i) != 0 && isInsideFeatureMask(currentCorners.at(i)))
+		{
+			previousCornersFiltered.push_back(previousCorners.at(i));
+			currentCornersFiltered.push_back(currentCorners.at(i));
+		}
+	}
+
+	cv::Mat currentTransformation;
+
+	// estimate the transformation between previous and current images trackable points
+	if (previousCornersFiltered.size() > 0 && currentCornersFiltered.size() > 0)
+		currentTransformation = cv::estimateRigidTransform(previousCornersFiltered, currentCornersFiltered, false);
+
+	return currentTransformation;
+}
+
+cv::Mat VideoStabilizer::estimatePhaseCorrelationTransformation(const cv::Mat& currentImage)
+{
+	cv::Mat currentImageFloat;
+	currentImage.convertTo(currentImageFloat, CV_32F);
+
+	// masked areas are faded out of the window so that they don't contribute to the correlation
+	if (correlationWindow.size() != currentImage.size())
+	{
+		cv::createHanningWindow(correlationWindow, currentImage.size(), CV_32F);
+
+		if (!featureMask.empty())
+		{
+			cv::Mat featureMaskFloat;
+			featureMask.convertTo(featureMaskFloat, CV_32F, 1.0 / 255.0);
+			cv::GaussianBlur(featureMaskFloat, featureMaskFloat, cv::Size(0, 0), 2.0);
+			correlationWindow = correlationWindow.mul(featureMaskFloat);
+		}
+	}
+
+	if (previousImageFloat.size() != currentImageFloat.size())
+		previousImage.convertTo(previousImageFloat, CV_32F);
+
+	double angle = 0.0;
+
+	// a rotation of the image rotates its magnitude spectrum the same way, which is a shift along the angle axis in log-polar space
+	if (estimator == VideoStabilizerEstimator::PhaseCorrelationRotation)
+	{
+		cv::Mat currentLogPolarSpectrum = calculateLogPolarSpectrum(currentImageFloat);
+
+		if (previousLogPolarSpectrum.size() == currentLogPolarSpectrum.size())
+		{
+			cv::Point2d spectrumShift = cv::phaseCorrelate(previousLogPolarSpectrum, currentLogPolarSpectrum);
+			angle = spectrumShift.y * 360.0 / currentLogPolarSpectrum.rows;
+		}
+
+		previousLogPolarSpectrum = currentLogPolarSpectrum;
+	}
+
+	cv::Point2d shift = cv::phaseCorrelate(previousImageFloat, currentImageFloat, correlationWindow);
+	previousImageFloat = currentImageFloat;
+
+	// rotation around the image center followed by the translation
+	double angleRadians = angle * M_PI / 180.0;
+	cv::Mat currentTransformation = (cv::Mat_<double>(2, 3) << cos(angleRadians), -sin(angleRadians), shift.x, sin(angleRadians), cos(angleRadians), shift.y);
+
+	return currentTransformation;
+}
+
+cv::Mat VideoStabilizer::calculateLogPolarSpectrum(const cv::Mat& image)
+{
+	cv::Mat windowedImage;
+	cv::multiply(image, correlationWindow, windowedImage);
+
+	cv::Mat spectrum;
+	cv::dft(windowedImage, spectrum, cv::DFT_COMPLEX_OUTPUT);
+
+	cv::Mat spectrumPlanes[2];
+	cv::split(spectrum, spectrumPlanes);
+
+	cv::Mat magnitude;
+	cv::magnitude(spectrumPlanes[0], spectrumPlanes[1], magnitude);
+	magnitude += cv::Scalar::all(1.0);
+	cv::log(magnitude, magnitude);
+
+	// move the zero frequency to the center
+	int centerX = magnitude.cols / 2;
+	int centerY = magnitude.rows / 2;
+	cv::Mat shiftedMagnitude(magnitude.size(), magnitude.type());
+	magnitude(cv::Rect(0, 0, centerX, centerY)).copyTo(shiftedMagnitude(cv::Rect(magnitude.cols - centerX, magnitude.rows - centerY, centerX, centerY)));
+	magnitude(cv::Rect(centerX, 0, magnitude.cols - centerX, centerY)).copyTo(shiftedMagnitude(cv::Rect(0, magnitude.rows - centerY, magnitude.cols - centerX, centerY)));
+	magnitude(cv::Rect(0, centerY, centerX, magnitude.rows - centerY)).copyTo(shiftedMagnitude(cv::Rect(magnitude.cols - centerX, 0, centerX, magnitude.rows - centerY)));
+	magnitude(cv::Rect(centerX, centerY, magnitude.cols - centerX, magnitude.rows - centerY)).copyTo(shiftedMagnitude(cv::Rect(0, 0, magnitude.cols - centerX, magnitude.rows - centerY)));
+
+	// columns are log radius, rows are angle (full circle)
+	cv::Mat logPolarSpectrum(shiftedMagnitude.size(), CV_32F);
+	double maxRadius = std::min(centerX, centerY);
+	IplImage sourceImage = shiftedMagnitude;
+	IplImage destinationImage = logPolarSpectrum;
+	cvLogPolar(&sourceImage, &destinationImage, cvPoint2D32f(centerX, centerY), shiftedMagnitude.cols / log(std::max(maxRadius, 2.0)), CV_INTER_LINEAR + CV_WARP_FILL_OUTLIERS);
+
+	return logPolarSpectrum;
+}
+
 FramePosition VideoStabilizer::searchNormalizedFramePosition(const FrameData& frameDataGrayscale)
 {
 	FramePosition result;
@@ -164,6 +536,39 @@ FramePosition VideoStabilizer::searchNormalizedFramePosition(const FrameData& fr
 	return result;
 }
 
+FramePosition VideoStabilizer::searchLookaheadFramePosition(const FrameData& frameDataGrayscale)
+{
+	QMutexLocker locker(&lookaheadMutex);
+
+	FramePosition result;
+
+	auto comparator = [](const OrientView::FramePosition& fp, const int64_t timeStamp) { return fp.timeStamp < timeStamp; };
+	auto searchResult = std::lower_bound(lookaheadFramePositions.begin(), lookaheadFramePositions.end(), frameDataGrayscale.timeStamp, comparator);
+
+	// the frame was decoded before the last reset and has not been analyzed
+	if (searchResult == lookaheadFramePositions.end() || (*searchResult).timeStamp != frameDataGrayscale.timeStamp)
+		return result;
+
+	int index = (int)(searchResult - lookaheadFramePositions.begin());
+
+	// positions older than the smoothing window are not needed anymore
+	if (index > lookaheadSmoothingRadius)
+	{
+		lookaheadFramePositions.erase(lookaheadFramePositions.begin(), lookaheadFramePositions.begin() + (index - lookaheadSmoothingRadius));
+		index = lookaheadSmoothingRadius;
+	}
+
+	FramePosition currentFp = lookaheadFramePositions.at(index);
+	FramePosition averageFp = calculateAverageFramePosition(lookaheadFramePositions, index, lookaheadSmoothingRadius);
+
+	result.timeStamp = currentFp.timeStamp;
+	result.x = averageFp.x - currentFp.x;
+	result.y = averageFp.y - currentFp.y;
+	result.angle = averageFp.angle - currentFp.angle;
+
+	return result;
+}
+
 void VideoStabilizer::convertCumulativeFramePositionsToNormalized(QFile& fileIn, QFile& fileOut, int smoothingRadius)
 {
 	QTextStream fileInStream(&fileIn);
@@ -194,36 +599,11 @@ void VideoStabilizer::convertCumulativeFramePositionsToNormalized(QFile& fileIn,
 
 	for (int i = 0; i < (int)positions.size(); ++i)
 	{
-		double sumX = 0.0;
-		double sumY = 0.0;
-		double sumAngle = 0.0;
-		int sumCount = 0;
-
-		for (int j = -smoothingRadius; j <= smoothingRadius; ++j)
-		{
-			if ((i + j) >= 0 && (i + j) < (int)positions.size())
-			{
-				FramePosition fp = positions.at(i + j);
-
-				sumX += fp.x;
-				sumY += fp.y;
-				sumAngle += fp.angle;
+		FramePosition averageFp = calculateAverageFramePosition(positions, i, smoothingRadius);
+		double averageX = averageFp.x;
+		double averageY = averageFp.y;
+		double averageAngle = averageFp.angle;
 
-				sumCount++;
-			}
-		}
-
-		double averageX = 0.0;
-		double averageY = 0.0;
-		double averageAngle = 0.0;
-
-		if (sumCount > 0)
-		{
-			averageX = sumX / (double)sumCount;
-			averageY = sumY / (double)sumCount;
-			averageAngle = sumAngle / (double)sumCount;
-		}
-		
 		FramePosition currentFp = positions.at(i);
 		FramePosition normalizedFp;
 
@@ -273,6 +653,46 @@ bool VideoStabilizer::readNormalizedFramePositions(const QString& fileName)
 	return true;
 }
 
+bool VideoStabilizer::readCumulativeFramePositions(const QString& fileName, int smoothingRadius)
+{
+	QFile file(fileName);
+
+	if (!file.open(QFile::ReadOnly | QFile::Text))
+	{
+		qWarning("Could not open cumulative input file");
+		return false;
+	}
+
+	QTextStream fileStream(&file);
+	QString fileInString = fileStream.readAll();
+	file.close();
+
+	QStringList lines = fileInString.split('\n');
+	std::vector<FramePosition> cumulativeFramePositions;
+
+	// the first line is either the column header or the cache fingerprint
+	for (int i = 1; i < lines.size(); ++i)
+	{
+		QStringList parts = lines.at(i).split(';');
+
+		if (parts.size() == 4)
+		{
+			FramePosition fp;
+
+			fp.timeStamp = (int64_t)parts[0].toLongLong();
+			fp.x = parts[1].toDouble();
+			fp.y = parts[2].toDouble();
+			fp.angle = parts[3].toDouble();
+
+			cumulativeFramePositions.push_back(fp);
+		}
+	}
+
+	normalizedFramePositions = calculateNormalizedFramePositions(cumulativeFramePositions, smoothingRadius);
+
+	return true;
+}
+
 void VideoStabilizer::toggleEnabled()
 {
 	isEnabled = !isEnabled;
@@ -281,6 +701,8 @@ void VideoStabilizer::toggleEnabled()
 
 void VideoStabilizer::reset()
 {
+	QMutexLocker locker(&lookaheadMutex);
+
 	cumulativeX = 0.0;
 	cumulativeY = 0.0;
 	cumulativeAngle = 0.0;
@@ -291,6 +713,10 @@ void VideoStabilizer::reset()
 
 	normalizedFramePosition = FramePosition();
 	previousTransformation = cv::Mat::eye(2, 3, CV_64F);
+	previousImageFloat = cv::Mat();
+	previousLogPolarSpectrum = cv::Mat();
+
+	lookaheadFramePositions.clear();
 
 	isFirstImage = true;
 	processDuration = 0.0;
@@ -311,12 +737,33 @@ double VideoStabilizer::getAngle() const
 	return normalizedFramePosition.angle;
 }
 
+int VideoStabilizer::getQualityLevel() const
+{
+	return qualityLevel;
+}
+
+int VideoStabilizer::getQualityLevelCount() const
+{
+	return stabilizerQualityCount;
+}
+
+double VideoStabilizer::getAnalysisScale() const
+{
+	return stabilizerQualities[qualityLevel].imageScale;
+}
+
 double VideoStabilizer::getProcessDuration() const
 {
 	return processDuration;
 }
 
+double VideoStabilizer::getAnalyzeDuration() const
+{
+	return analyzeDuration;
+}
+
 void VideoStabilizer::resetProcessDuration()
 {
 	processDuration = 0.0;
+	analyzeDuration = 0.0;
 }
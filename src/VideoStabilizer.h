@@ -3,10 +3,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 
 #include <QFile>
 #include <QElapsedTimer>
+#include <QMutex>
 
 #include "opencv2/opencv.hpp"
 
@@ -25,7 +28,8 @@ namespace OrientView
 		double angle = 0.0;
 	};
 
-	enum VideoStabilizerMode { RealTime, Preprocessed };
+	enum VideoStabilizerMode { RealTime, Preprocessed, RealTimeLookahead };
+	enum VideoStabilizerEstimator { FeatureTracking, PhaseCorrelation, PhaseCorrelationRotation };
 
 	// Use the OpenCV library to do real-time video stabilization.
 	class VideoStabilizer
@@ -33,13 +37,16 @@ namespace OrientView
 
 	public:
 
-		bool initialize(Settings* settings, bool isPreprocessing);
+		bool initialize(Settings* settings, bool isPreprocessing, const QString& cacheFilePath = QString());
 
 		void preProcessFrame(const FrameData& frameDataGrayscale, QFile& file);
+		void analyzeFrame(const FrameData& frameDataGrayscale);
 		void processFrame(const FrameData& frameDataGrayscale);
+		FramePosition calculateCumulativeFramePosition(const FrameData& frameDataGrayscale);
 
 		static void convertCumulativeFramePositionsToNormalized(QFile& fileIn, QFile& fileOut, int smoothingRadius);
 		bool readNormalizedFramePositions(const QString& fileName);
+		bool readCumulativeFramePositions(const QString& fileName, int smoothingRadius);
 
 		void toggleEnabled();
 		void reset();
@@ -48,22 +55,35 @@ namespace OrientView
 		double getY() const;
 		double getAngle() const;
 
+		int getQualityLevel() const;
+		int getQualityLevelCount() const;
+		double getAnalysisScale() const;
 		double getProcessDuration() const;
+		double getAnalyzeDuration() const;
 		void resetProcessDuration();
 
 	private:
 
-		FramePosition calculateCumulativeFramePosition(const FrameData& frameDataGrayscale);
+		void updateFeatureMask(const cv::Mat& currentImage, int64_t frameDuration);
+		bool isInsideFeatureMask(const cv::Point2f& point) const;
+		void updateQualityLevel(double analysisDuration, double frameBudget);
+		cv::Mat estimateFeatureTrackingTransformation(const cv::Mat& currentImage);
+		cv::Mat estimatePhaseCorrelationTransformation(const cv::Mat& currentImage);
+		cv::Mat calculateLogPolarSpectrum(const cv::Mat& image);
 		FramePosition searchNormalizedFramePosition(const FrameData& frameDataGrayscale);
+		FramePosition searchLookaheadFramePosition(const FrameData& frameDataGrayscale);
 
 		VideoStabilizerMode mode = VideoStabilizerMode::Preprocessed;
+		VideoStabilizerEstimator estimator = VideoStabilizerEstimator::FeatureTracking;
 
 		bool isFirstImage = true;
-		bool isEnabled = true;
+		std::atomic<bool> isEnabled { true }; // the decoder thread analyzes frames while the user toggles this
 
 		double dampingFactor = 0.0;
 		double maxDisplacementFactor = 0.0;
 		double maxAngle = 5.0;
+		int lookaheadFrameCount = 15;
+		int lookaheadSmoothingRadius = 15;
 
 		double cumulativeX = 0.0;
 		double cumulativeY = 0.0;
@@ -74,13 +94,37 @@ namespace OrientView
 		MovingAverage cumulativeAngleAverage;
 
 		std::vector<FramePosition> normalizedFramePositions;
+		std::deque<FramePosition> lookaheadFramePositions;
+		QMutex lookaheadMutex;
 
 		FramePosition normalizedFramePosition;
 
 		cv::Mat previousImage;
 		cv::Mat previousTransformation;
+		cv::Mat previousImageFloat;
+		cv::Mat previousLogPolarSpectrum;
+		cv::Mat correlationWindow;
+
+		std::vector<cv::Rect_<double>> maskRectangles;
+		double autoMaskDuration = 0.0;
+		double autoMaskThreshold = 2.0;
+		double autoMaskElapsedTime = 0.0;
+		int differenceCount = 0;
+		cv::Mat differenceSum;
+		cv::Mat staticPixelMask;
+		cv::Mat featureMask;
+
+		bool useAdaptiveQuality = false;
+		double adaptiveBudgetFactor = 0.5;
+		std::atomic<int> qualityLevel { 0 };
+		int qualityLevelFrameCount = 0;
+		MovingAverage analysisDurationAverage;
+		QElapsedTimer analysisDurationTimer;
+		cv::Mat scaledImage;
 
 		QElapsedTimer processDurationTimer;
-		double processDuration = 0.0;
+		QElapsedTimer analyzeDurationTimer;
+		std::atomic<double> processDuration { 0.0 };
+		std::atomic<double> analyzeDuration { 0.0 }; // the lookahead analysis runs on the decoder thread, outside of processFrame
 	};
 }
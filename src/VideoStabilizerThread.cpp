@@ -23,6 +23,9 @@ bool VideoStabilizerThread::initialize(VideoDecoder* videoDecoder, VideoStabiliz
 	}
 
 	outputFile.write("timeStamp;cumulativeX;cumulativeY;cumulativeAngle\n");
+
+	useCache = settings->stabilizer.useCache && stabilizerCache.initialize(settings);
+
 	return true;
 }
 
@@ -60,5 +63,9 @@ void VideoStabilizerThread::run()
 	if (outputFile.isOpen())
 		outputFile.close();
 
+	// only a complete analysis is worth keeping
+	if (useCache && videoDecoder->getIsFinished())
+		stabilizerCache.storeCumulativeFramePositions(outputFile.fileName());
+
 	emit processingFinished();
 }
@@ -6,6 +6,8 @@
 #include <QThread>
 #include <QFile>
 
+#include "StabilizerCache.h"
+
 namespace OrientView
 {
 	class VideoDecoder;
@@ -38,6 +40,8 @@ namespace OrientView
 		VideoStabilizer* videoStabilizer = nullptr;
 
 		QFile outputFile;
+		StabilizerCache stabilizerCache;
+		bool useCache = false;
 
 		bool isPaused = false;
 	};
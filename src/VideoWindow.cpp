@@ -29,6 +29,8 @@ bool VideoWindow::initialize(Settings* settings)
 
 	QSurfaceFormat surfaceFormat;
 	surfaceFormat.setSamples(settings->window.multisamples);
+	surfaceFormat.setStencilBufferSize(8);
+	surfaceFormat.setSwapInterval(settings->window.swapInterval);
 	this->setFormat(surfaceFormat);
 
 	context = new QOpenGLContext();